@@ -9,5 +9,8 @@ public class GameAI : ModuleRules
 		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 
 		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "EnhancedInput", "ProceduralMeshComponent", "NavigationSystem" });
+
+		// Detour headers, for reading the nav tile salts when the navmesh is rebuilt
+		PrivateDependencyModuleNames.AddRange(new string[] { "Navmesh" });
 	}
 }
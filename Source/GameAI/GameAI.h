@@ -3,3 +3,7 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+// Use "stat GameAI" in the console to see where our AI time is going
+DECLARE_STATS_GROUP(TEXT("GameAI"), STATGROUP_GameAI, STATCAT_Advanced);
@@ -1,11 +1,40 @@
 #include "GAGridActor.h"
+#include "GAVisibilityField.h"
 
 #include "Components/SceneComponent.h"
 #include "Components/BoxComponent.h"
 #include "ProceduralMeshComponent.h"
 #include "NavigationSystem.h"
 #include "NavMesh/RecastNavMesh.h"
+#if WITH_RECAST
+#include "Detour/DetourNavMesh.h"
+#endif
 #include "Engine/Texture2D.h"
+#include "Async/ParallelFor.h"
+#include "EngineUtils.h"
+#include "GameAI/GameAI.h"
+
+DECLARE_CYCLE_STAT(TEXT("GA Refresh Data From Nav"), STAT_GARefreshDataFromNav, STATGROUP_GameAI);
+
+
+static FAutoConsoleCommandWithWorld VisibilitySetStatsCommand(
+	TEXT("GameAI.VisibilitySetStats"),
+	TEXT("Log the size of the baked visibility set of every grid actor."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		for (TActorIterator<AGAGridActor> It(World); It; ++It)
+		{
+			const FGAVisibilitySet& VisibilitySet = It->GetVisibilitySet();
+			if (VisibilitySet.IsValidFor(It->XCount, It->YCount))
+			{
+				VisibilitySet.LogStats();
+			}
+			else
+			{
+				UE_LOG(LogTemp, Log, TEXT("%s has no visibility set."), *It->GetName());
+			}
+		}
+	}));
 
 
 FCellRef FCellRef::Invalid(INDEX_NONE, INDEX_NONE);
@@ -38,6 +67,13 @@ AGAGridActor::AGAGridActor(const FObjectInitializer& ObjectInitializer)
 
 	DebugMeshZOffset = 30.0f;
 
+	bBuildJumpPointTable = true;
+	bBuildHierarchy = false;
+	HierarchyClusterSize = 16;
+	bBuildVisibilitySet = false;
+	VisibilitySetClusterSize = 4;
+
+	bRefreshOnNavUpdates = true;
 }
 
 void AGAGridActor::PostLoad()
@@ -48,6 +84,9 @@ void AGAGridActor::PostLoad()
 
 	RefreshDerivedValues();
 	Super::PostLoad();
+
+	// Data is serialized, but none of the stuff we compute from it is
+	RefreshDerivedData();
 }
 
 
@@ -165,6 +204,44 @@ FVector2D AGAGridActor::GetCellGridSpacePosition(const FCellRef& CellRef) const
 
 
 
+FVector2D AGAGridActor::GetGridSpacePosition(const FVector& Point) const
+{
+	return FVector2D(GetActorTransform().InverseTransformPosition(Point)) + HalfExtents;
+}
+
+
+bool AGAGridActor::HasGridLineOfSight(const FVector& From, const FVector& To) const
+{
+	// The bit plane works in cells
+	return TraversableBits.IsLineClear(GetGridSpacePosition(From) / CellScale, GetGridSpacePosition(To) / CellScale);
+}
+
+
+bool AGAGridActor::BuildVisibilityField(const FCellRef& Origin, const FGridBox& Box, FGAVisibilityField& FieldOut) const
+{
+	FieldOut.GridVersion = GridVersion;
+	return FieldOut.Build(TraversableBits, Origin, Box);
+}
+
+
+bool AGAGridActor::HasCellLineOfSight(const FCellRef& A, const FCellRef& B) const
+{
+	if (VisibilitySet.IsValidFor(XCount, YCount))
+	{
+		if (!VisibilitySet.IsPotentiallyVisible(A.X, A.Y, B.X, B.Y))
+		{
+			return false;
+		}
+		if (VisibilitySet.IsExact())
+		{
+			return true;
+		}
+	}
+
+	return TraversableBits.IsLineClear(FVector2D(A.X + 0.5, A.Y + 0.5), FVector2D(B.X + 0.5, B.Y + 0.5));
+}
+
+
 ECellData AGAGridActor::GetCellData(const FCellRef &CellRef) const
 {
 	int32 CellIndex = CellRefToIndex(CellRef);
@@ -187,124 +264,754 @@ bool AGAGridActor::GridSpaceBoundsToRect2D(const FBox2D& Box, FIntRect &RectOut)
 
 // Data from NavSystem --------------------------------
 
+// A run of cells in one row, MinX to MaxX inclusive
+struct FCellSpan
+{
+	int32 Y;
+	int32 MinX;
+	int32 MaxX;
+};
+
+// Scanline-rasterize a convex polygon (in grid space) into spans of cells. A cell is covered if its center is inside
+// (or exactly on the edge of) the polygon. For each row we intersect the horizontal line through the cell centers with
+// the polygon's edges, and the cells between the leftmost and rightmost crossing are the covered span.
+static void RasterizeConvexPoly(const TArray<FVector2D>& Verts, float CellScale, int32 XCount, int32 YCount, TArray<FCellSpan>& SpansOut)
+{
+	FBox2D PolyBounds(EForceInit::ForceInit);
+	for (const FVector2D& Vert : Verts)
+	{
+		PolyBounds += Vert;
+	}
+
+	// Rows whose centers fall inside the vertical extent of the poly
+	const float InvScale = 1.0f / CellScale;
+	const int32 MinY = FMath::Max(FMath::CeilToInt32(PolyBounds.Min.Y * InvScale - 0.5f), 0);
+	const int32 MaxY = FMath::Min(FMath::FloorToInt32(PolyBounds.Max.Y * InvScale - 0.5f), YCount - 1);
+
+	const int32 VertCount = Verts.Num();
+
+	for (int32 Y = MinY; Y <= MaxY; Y++)
+	{
+		const double RowY = (double(Y) + 0.5) * CellScale;
+		double SpanMin = UE_DOUBLE_BIG_NUMBER;
+		double SpanMax = -UE_DOUBLE_BIG_NUMBER;
+
+		for (int32 V0Index = 0; V0Index < VertCount; V0Index++)
+		{
+			const FVector2D& V0 = Verts[V0Index];
+			const FVector2D& V1 = Verts[(V0Index + 1) % VertCount];
+
+			if ((RowY < FMath::Min(V0.Y, V1.Y)) || (RowY > FMath::Max(V0.Y, V1.Y)))
+			{
+				continue;
+			}
+
+			if (V0.Y == V1.Y)
+			{
+				// Edge lies along the row
+				SpanMin = FMath::Min(SpanMin, FMath::Min(V0.X, V1.X));
+				SpanMax = FMath::Max(SpanMax, FMath::Max(V0.X, V1.X));
+			}
+			else
+			{
+				const double Alpha = (RowY - V0.Y) / (V1.Y - V0.Y);
+				const double CrossX = V0.X + Alpha * (V1.X - V0.X);
+				SpanMin = FMath::Min(SpanMin, CrossX);
+				SpanMax = FMath::Max(SpanMax, CrossX);
+			}
+		}
+
+		if (SpanMin > SpanMax)
+		{
+			continue;
+		}
+
+		FCellSpan Span;
+		Span.Y = Y;
+		Span.MinX = FMath::Max(FMath::CeilToInt32(SpanMin * InvScale - 0.5), 0);
+		Span.MaxX = FMath::Min(FMath::FloorToInt32(SpanMax * InvScale - 0.5), XCount - 1);
+		if (Span.MinX <= Span.MaxX)
+		{
+			SpansOut.Add(Span);
+		}
+	}
+}
+
+// What we need to know about the grid to rasterize nav polys into it. Copied out of the actor so the
+// tiles can be rasterized in parallel without touching it.
+struct FNavRasterContext
+{
+	FTransform ActorTransform;
+	FVector2D HalfExtents;
+	float CellScale;
+	int32 XCount;
+	int32 YCount;
+};
+
+// Rasterize every poly in one nav tile
+static void RasterizeNavTile(const ARecastNavMesh* NavMesh, int32 TileIndex, const FNavRasterContext& Context, TArray<FCellSpan>& SpansOut)
+{
+	const FBox TileBounds = NavMesh->GetNavMeshTileBounds(TileIndex);
+	if (!TileBounds.IsValid)			// reportedly will crash if this is not checked
+	{
+		return;
+	}
+
+	TArray<FNavPoly> Polys;
+	if (!NavMesh->GetPolysInTile(TileIndex, Polys))
+	{
+		return;
+	}
+
+	TArray<FVector> PolyVerts;
+	TArray<FVector2D> PolyVerts2D;
+
+	for (const FNavPoly& NavPoly : Polys)
+	{
+		PolyVerts.Reset();
+		NavMesh->GetPolyVerts(NavPoly.Ref, PolyVerts);
+		PolyVerts2D.SetNum(PolyVerts.Num());
+
+		// transform verts to grid space
+		for (int32 VertexIndex = 0; VertexIndex < PolyVerts.Num(); VertexIndex++)
+		{
+			PolyVerts2D[VertexIndex] = FVector2D(Context.ActorTransform.InverseTransformPosition(PolyVerts[VertexIndex])) + Context.HalfExtents;
+		}
+
+		RasterizeConvexPoly(PolyVerts2D, Context.CellScale, Context.XCount, Context.YCount, SpansOut);
+	}
+}
+
+// The number of tile slots in the navmesh. Note that this is not GetNavMeshTilesCount, which only counts the
+// slots that actually have a tile in them -- once tiles start being rebuilt the empty slots can be anywhere.
+static int32 GetNavTileSlotCount(const ARecastNavMesh* NavMesh)
+{
+#if WITH_RECAST
+	const dtNavMesh* DetourMesh = NavMesh->GetRecastMesh();
+	return DetourMesh ? DetourMesh->getMaxTiles() : 0;
+#else
+	return NavMesh->GetNavMeshTilesCount();
+#endif
+}
+
 bool AGAGridActor::RefreshDataFromNav()
 {
+	SCOPE_CYCLE_COUNTER(STAT_GARefreshDataFromNav);
+
 	bool Result = false;
 	UNavigationSystemV1 *NavSystem = UNavigationSystemV1::GetNavigationSystem(this);
 	if (NavSystem)
 	{
 		INavigationDataInterface* NavData = NavSystem->GetMainNavData();		// Note: only using the default nav data here
 		const ARecastNavMesh* NavMesh = Cast<ARecastNavMesh>(NavData);
-		FTransform ActorTransform = GetActorTransform();
+		if (!NavMesh)
+		{
+			return false;
+		}
+
+		const double StartTime = FPlatformTime::Seconds();
+		const int32 TileCount = GetNavTileSlotCount(NavMesh);
+		const FNavRasterContext Context{ GetActorTransform(), HalfExtents, CellScale, XCount, YCount };
+
+		// Code for extracting nav polys taken from here:
+		// https://nerivec.github.io/old-ue4-wiki/pages/ai-navigation-in-c-customize-path-following-every-tick.html
+
+		// Rasterize the tiles in parallel. Each tile writes its covered spans into its own array, so the workers
+		// never touch shared data -- the spans all get merged into the grid afterwards.
+		TArray<TArray<FCellSpan>> TileSpans;
+		TileSpans.SetNum(TileCount);
+
+		ParallelFor(TileCount, [&](int32 TileIndex)
+		{
+			RasterizeNavTile(NavMesh, TileIndex, Context, TileSpans[TileIndex]);
+		});
 
 		// Allocate the array and set to 0
 		ResetData();
 
+		// Merge
 		ECellData* CellData = GetData();
+		for (const TArray<FCellSpan>& Spans : TileSpans)
+		{
+			for (const FCellSpan& Span : Spans)
+			{
+				ECellData* Row = CellData + Span.Y * XCount;
+				for (int32 X = Span.MinX; X <= Span.MaxX; X++)
+				{
+					// turn on the traversable bit
+					EnumAddFlags(Row[X], ECellData::CellDataTraversable);
+				}
+			}
+		}
 
-		// Code for extracting nav polys taken from here:
-		// https://nerivec.github.io/old-ue4-wiki/pages/ai-navigation-in-c-customize-path-following-every-tick.html
+		// Remember what the tiles looked like, so later nav updates only have to redo the tiles that changed
+		UpdateNavTileStates(NavMesh, nullptr);
+
+		RefreshDerivedData();
+
+		UE_LOG(LogTemp, Log, TEXT("RefreshDataFromNav: rasterized %d nav tiles in %.2f ms"), TileCount, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+		Result = true;
+	}
+
+	return Result;
+}
+
+
+// Incremental updates from the NavSystem --------------------------------
+
+void AGAGridActor::BeginPlay()
+{
+	Super::BeginPlay();
+
+	UNavigationSystemV1* NavSystem = UNavigationSystemV1::GetNavigationSystem(this);
+	if (bRefreshOnNavUpdates && NavSystem)
+	{
+		NavSystem->OnNavigationGenerationFinishedDelegate.AddUniqueDynamic(this, &AGAGridActor::OnNavigationGenerationFinished);
+
+		// If the grid was filled in the editor we haven't seen the tiles yet
+		const ARecastNavMesh* NavMesh = Cast<ARecastNavMesh>(NavSystem->GetMainNavData());
+		if (NavMesh && (NavTileStates.Num() == 0))
+		{
+			UpdateNavTileStates(NavMesh, nullptr);
+		}
+	}
+}
+
+void AGAGridActor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UNavigationSystemV1* NavSystem = UNavigationSystemV1::GetNavigationSystem(this);
+	if (NavSystem)
+	{
+		NavSystem->OnNavigationGenerationFinishedDelegate.RemoveDynamic(this, &AGAGridActor::OnNavigationGenerationFinished);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AGAGridActor::OnNavigationGenerationFinished(ANavigationData* NavData)
+{
+	const ARecastNavMesh* NavMesh = Cast<ARecastNavMesh>(NavData);
+	UNavigationSystemV1* NavSystem = UNavigationSystemV1::GetNavigationSystem(this);
+	if (!NavMesh || !NavSystem || (NavData != NavSystem->GetMainNavData()))
+	{
+		return;
+	}
+
+	if (Data.Num() != GetCellCount())
+	{
+		// Never been filled in, so there's nothing to patch up
+		RefreshDataFromNav();
+		return;
+	}
+
+	TArray<FIntRect> DirtyRects;
+	UpdateNavTileStates(NavMesh, &DirtyRects);
+
+	if (DirtyRects.Num() > 0)
+	{
+		RefreshDataFromNavInRects(NavMesh, DirtyRects);
+	}
+}
+
+bool AGAGridActor::GetNavTileCellRect(const ARecastNavMesh* NavMesh, int32 TileIndex, FIntRect& RectOut) const
+{
+	const FBox TileBounds = NavMesh->GetNavMeshTileBounds(TileIndex);
+	if (!TileBounds.IsValid)
+	{
+		return false;
+	}
+
+	// The grid can be rotated, so take the grid space bounds of all four corners
+	const FTransform ActorTransform = GetActorTransform();
+	FBox2D GridBounds(EForceInit::ForceInit);
+	GridBounds += FVector2D(ActorTransform.InverseTransformPosition(FVector(TileBounds.Min.X, TileBounds.Min.Y, TileBounds.Min.Z)));
+	GridBounds += FVector2D(ActorTransform.InverseTransformPosition(FVector(TileBounds.Max.X, TileBounds.Min.Y, TileBounds.Min.Z)));
+	GridBounds += FVector2D(ActorTransform.InverseTransformPosition(FVector(TileBounds.Min.X, TileBounds.Max.Y, TileBounds.Min.Z)));
+	GridBounds += FVector2D(ActorTransform.InverseTransformPosition(FVector(TileBounds.Max.X, TileBounds.Max.Y, TileBounds.Min.Z)));
+
+	// Conservative: every cell the bounds touch, not just the ones whose centers are inside
+	RectOut.Min.X = FMath::Max(FMath::FloorToInt32((GridBounds.Min.X + HalfExtents.X) / CellScale), 0);
+	RectOut.Max.X = FMath::Min(FMath::FloorToInt32((GridBounds.Max.X + HalfExtents.X) / CellScale), XCount - 1);
+	RectOut.Min.Y = FMath::Max(FMath::FloorToInt32((GridBounds.Min.Y + HalfExtents.Y) / CellScale), 0);
+	RectOut.Max.Y = FMath::Min(FMath::FloorToInt32((GridBounds.Max.Y + HalfExtents.Y) / CellScale), YCount - 1);
+
+	return (RectOut.Min.X <= RectOut.Max.X) && (RectOut.Min.Y <= RectOut.Max.Y);
+}
 
-		for (int32 TileIndex = 0; TileIndex < NavMesh->GetNavMeshTilesCount(); TileIndex++)
+void AGAGridActor::UpdateNavTileStates(const ARecastNavMesh* NavMesh, TArray<FIntRect>* DirtyRectsOut)
+{
+#if WITH_RECAST
+	const dtNavMesh* DetourMesh = NavMesh->GetRecastMesh();
+	const int32 TileCount = DetourMesh ? DetourMesh->getMaxTiles() : 0;
+
+	// Slots we had last time but don't any more (the navmesh got smaller) count as removed tiles
+	if (DirtyRectsOut)
+	{
+		for (int32 TileIndex = TileCount; TileIndex < NavTileStates.Num(); TileIndex++)
 		{
-			const FBox TileBounds = NavMesh->GetNavMeshTileBounds(TileIndex);
-			if (TileBounds.IsValid)			// reportedly will crash if this is not checked
+			if (NavTileStates[TileIndex].bHasCells)
 			{
-				TArray<FNavPoly> Polys;
+				DirtyRectsOut->Add(NavTileStates[TileIndex].CellRect);
+			}
+		}
+	}
+	NavTileStates.SetNum(TileCount);
 
-				if (NavMesh->GetPolysInTile(TileIndex, Polys))
-				{
-					for (FNavPoly& NavPoly : Polys)
-					{
-						TArray<FVector> PolyVerts;
-						TArray<FVector2D> PolyVerts2D;
-						NavNodeRef Ref = NavPoly.Ref;
-
-						NavMesh->GetPolyVerts(Ref, PolyVerts);
-						PolyVerts2D.SetNum(PolyVerts.Num());
-
-						// transform verts to local space
-						for (int32 VertexIndex = 0; VertexIndex < PolyVerts.Num(); VertexIndex++)
-						{
-							PolyVerts2D[VertexIndex] = FVector2D(ActorTransform.InverseTransformPosition(PolyVerts[VertexIndex])) + HalfExtents;
-						}
-
-						{
-							FBox2D PolyBounds(EForceInit::ForceInit);
-							for (const FVector2D& Vert : PolyVerts2D)
-							{
-								PolyBounds += Vert;
-							}
-
-							FIntRect GridBox;
-							if (GridSpaceBoundsToRect2D(PolyBounds, GridBox))
-							{
-								TArray<FVector2D> OutsideVectors;
-								OutsideVectors.SetNum(PolyVerts2D.Num());
-
-								// Cache off a set of "outside vectors", so that we can test each cell in the box against the
-								// bounds of the polygons
-
-								for (int32 V0Index = 0; V0Index < PolyVerts2D.Num(); V0Index++)
-								{
-									int32 V1Index = (V0Index + 1) % PolyVerts2D.Num();
-									FVector2D& V0 = PolyVerts2D[V0Index];
-									FVector2D& V1 = PolyVerts2D[V1Index];
-									FVector2D V0V1 = V1 - V0;
-
-									// Rotate 90 degrees
-									FVector2D &OutsideVector = OutsideVectors[V0Index];
-									OutsideVector.X = -V0V1.Y;
-									OutsideVector.Y = V0V1.X;
-								}
-
-								// Grid box now represents the intersection between Grid and the poly in question.
-								// Check each cell in the box to see if it's inside the poly
-
-								// Note, this is way inefficient
-								// A smarter way would be to use some kind of rasterization approach
-
-								for (int Y = GridBox.Min.Y; Y <= GridBox.Max.Y; Y++)
-								{
-									for (int X = GridBox.Min.X; X <= GridBox.Max.X; X++)
-									{
-										FCellRef CellRef(X, Y);
-										FVector2D CellCenter = GetCellGridSpacePosition(CellRef);
-										bool IsOutside = false;
-
-										for (int32 V0Index = 0; (V0Index < PolyVerts2D.Num()) && !IsOutside; V0Index++)
-										{
-											FVector2D& V0 = PolyVerts2D[V0Index];
-											FVector2D &OutsideVector = OutsideVectors[V0Index];
-											FVector2D V0Cell = CellCenter - V0;
-
-											if ((V0Cell | OutsideVector) > 0.0f)		// Dot product
-											{
-												// the cell is outside this edge
-												IsOutside = true;
-											}
-										}
-
-										int32 CellIndex = CellRefToIndex(CellRef);
-										if (!IsOutside)
-										{
-											// turn on the traversable bit
-											EnumAddFlags(CellData[CellIndex], ECellData::CellDataTraversable);
-										}
-									}
-								}
-							}
-						}
-					}
-				}
+	for (int32 TileIndex = 0; TileIndex < TileCount; TileIndex++)
+	{
+		const dtMeshTile* Tile = DetourMesh->getTile(TileIndex);
+		const uint32 Salt = (Tile && Tile->header) ? Tile->salt : 0;		// empty slots all look the same
+
+		FNavTileState& State = NavTileStates[TileIndex];
+		if (DirtyRectsOut && (State.Salt == Salt))
+		{
+			continue;
+		}
+
+		if (DirtyRectsOut && State.bHasCells)
+		{
+			DirtyRectsOut->Add(State.CellRect);
+		}
+
+		State.Salt = Salt;
+		State.bHasCells = (Salt != 0) && GetNavTileCellRect(NavMesh, TileIndex, State.CellRect);
+
+		if (DirtyRectsOut && State.bHasCells)
+		{
+			DirtyRectsOut->Add(State.CellRect);
+		}
+	}
+#else
+	NavTileStates.Reset();
+#endif
+}
+
+void AGAGridActor::RefreshDataFromNavInRects(const ARecastNavMesh* NavMesh, const TArray<FIntRect>& DirtyRects)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GARefreshDataFromNav);
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	// Clear the traversable bit in the dirty cells, and work out which box we've touched
+	FIntRect ChangedRect = DirtyRects[0];
+	ECellData* CellData = GetData();
+	for (const FIntRect& Rect : DirtyRects)
+	{
+		ChangedRect.Union(Rect);
+		for (int32 Y = Rect.Min.Y; Y <= Rect.Max.Y; Y++)
+		{
+			ECellData* Row = CellData + Y * XCount;
+			for (int32 X = Rect.Min.X; X <= Rect.Max.X; X++)
+			{
+				EnumRemoveFlags(Row[X], ECellData::CellDataTraversable);
+			}
+		}
+	}
+
+	// Any tile overlapping a dirty rect may have polys over the cells we just cleared, so redo all of them.
+	// Their spans outside the dirty rects only set bits that are already set, so no need to clip.
+	// Note: FIntRect::Intersect treats Max as exclusive, but our rects are inclusive, hence the hand rolled test.
+	TArray<int32> TilesToRasterize;
+	for (int32 TileIndex = 0; TileIndex < NavTileStates.Num(); TileIndex++)
+	{
+		const FNavTileState& State = NavTileStates[TileIndex];
+		if (!State.bHasCells)
+		{
+			continue;
+		}
+
+		for (const FIntRect& Rect : DirtyRects)
+		{
+			if ((State.CellRect.Min.X <= Rect.Max.X) && (State.CellRect.Max.X >= Rect.Min.X) &&
+				(State.CellRect.Min.Y <= Rect.Max.Y) && (State.CellRect.Max.Y >= Rect.Min.Y))
+			{
+				TilesToRasterize.Add(TileIndex);
+				break;
+			}
+		}
+	}
+
+	const FNavRasterContext Context{ GetActorTransform(), HalfExtents, CellScale, XCount, YCount };
+	TArray<TArray<FCellSpan>> TileSpans;
+	TileSpans.SetNum(TilesToRasterize.Num());
+
+	ParallelFor(TilesToRasterize.Num(), [&](int32 Index)
+	{
+		RasterizeNavTile(NavMesh, TilesToRasterize[Index], Context, TileSpans[Index]);
+	});
+
+	for (const TArray<FCellSpan>& Spans : TileSpans)
+	{
+		for (const FCellSpan& Span : Spans)
+		{
+			ECellData* Row = CellData + Span.Y * XCount;
+			for (int32 X = Span.MinX; X <= Span.MaxX; X++)
+			{
+				EnumAddFlags(Row[X], ECellData::CellDataTraversable);
+			}
+		}
+	}
+
+	RefreshDerivedDataInBox(FGridBox(ChangedRect));
+
+	UE_LOG(LogTemp, Log, TEXT("RefreshDataFromNavInRects: %d dirty rects, re-rasterized %d nav tiles in %.2f ms"),
+		DirtyRects.Num(), TilesToRasterize.Num(), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+}
+
+
+// Derived Data --------------------------------
+
+void AGAGridActor::RefreshDerivedData()
+{
+	if (Data.Num() != GetCellCount())
+	{
+		// Haven't been filled in yet
+		TraversableBits.Empty();
+		Clearance.Empty();
+		ComponentLabels.Empty();
+		ComponentCount = 0;
+		JumpPointTable.Empty();
+		HierarchicalGraph.Empty();
+		VisibilitySet.Empty();
+		return;
+	}
+
+	// Everything else reads the bits, so they go first
+	TraversableBits.Init(XCount, YCount);
+	RefreshTraversableBits(0, YCount - 1);
+	RefreshClearance();
+	RefreshComponents();
+
+	if (bBuildJumpPointTable)
+	{
+		JumpPointTable.Build(this);
+	}
+	else
+	{
+		JumpPointTable.Empty();
+	}
+
+	if (bBuildHierarchy)
+	{
+		HierarchicalGraph.Build(this, HierarchyClusterSize);
+	}
+	else
+	{
+		HierarchicalGraph.Empty();
+	}
+
+	if (bBuildVisibilitySet)
+	{
+		VisibilitySet.Build(TraversableBits, VisibilitySetClusterSize);
+	}
+	else
+	{
+		VisibilitySet.Empty();
+	}
+
+	const FGridBox AllCells(0, XCount - 1, 0, YCount - 1);
+	BumpVersions(AllCells);
+	OnCellsChanged.Broadcast(AllCells);
+}
+
+void AGAGridActor::RefreshDerivedDataInBox(const FGridBox& ChangedCells)
+{
+	if ((Data.Num() != GetCellCount()) || !ChangedCells.IsValid() || !TraversableBits.IsValidFor(XCount, YCount))
+	{
+		RefreshDerivedData();
+		return;
+	}
+
+	RefreshTraversableBits(FMath::Max(ChangedCells.MinY, 0), FMath::Min(ChangedCells.MaxY, YCount - 1));
+
+	// A change can move the clearance of cells a long way off, and it's just two sweeps, so redo it all
+	RefreshClearance();
+
+	// Same for the components: blocking one cell can split a region anywhere along its length
+	RefreshComponents();
+
+	// Note: a change can shift jump points anywhere along the rows, columns and diagonals through the box,
+	// and the table is only a couple of linear sweeps anyway, so just redo the lot
+	if (bBuildJumpPointTable)
+	{
+		JumpPointTable.Build(this);
+	}
+
+	if (bBuildHierarchy)
+	{
+		HierarchicalGraph.RebuildRegion(this, ChangedCells);
+	}
+
+	// The visibility set is for static grids, and baking it again would take far too long to do here
+	if (VisibilitySet.IsValidFor(XCount, YCount))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("AGAGridActor: cells changed at runtime, dropping the visibility set."));
+		VisibilitySet.Empty();
+	}
+
+	BumpVersions(ChangedCells);
+	OnCellsChanged.Broadcast(ChangedCells);
+}
+
+
+void AGAGridActor::RefreshTraversableBits(int32 MinY, int32 MaxY)
+{
+	// Gather each row into runs, rather than poking one bit at a time
+	for (int32 Y = MinY; Y <= MaxY; Y++)
+	{
+		const ECellData* Row = Data.GetData() + Y * XCount;
+		TraversableBits.SetSpan(Y, 0, XCount - 1, false);
+
+		int32 RunStart = INDEX_NONE;
+		for (int32 X = 0; X <= XCount; X++)
+		{
+			const bool bTraversable = (X < XCount) && EnumHasAllFlags(Row[X], ECellData::CellDataTraversable);
+			if (bTraversable && (RunStart == INDEX_NONE))
+			{
+				RunStart = X;
+			}
+			else if (!bTraversable && (RunStart != INDEX_NONE))
+			{
+				TraversableBits.SetSpan(Y, RunStart, X - 1, true);
+				RunStart = INDEX_NONE;
 			}
 		}
 	}
+}
+
+
+// Versions --------------------------------
+
+void AGAGridActor::BumpVersions(const FGridBox& ChangedCells)
+{
+	const int32 RegionsX = FMath::DivideAndRoundUp(XCount, VersionRegionSize);
+	const int32 RegionsY = FMath::DivideAndRoundUp(YCount, VersionRegionSize);
 
+	GridVersion++;
+
+	if ((RegionsX != VersionRegionsX) || (RegionVersions.Num() != RegionsX * RegionsY))
+	{
+		// Grid changed size, so everything is new
+		VersionRegionsX = RegionsX;
+		RegionVersions.Init(GridVersion, RegionsX * RegionsY);
+		return;
+	}
+
+	// Note: a cell change can affect paths through its neighbours too (no corner cutting), so grow by one
+	const int32 MinRX = FMath::Max(ChangedCells.MinX - 1, 0) / VersionRegionSize;
+	const int32 MaxRX = FMath::Min(ChangedCells.MaxX + 1, XCount - 1) / VersionRegionSize;
+	const int32 MinRY = FMath::Max(ChangedCells.MinY - 1, 0) / VersionRegionSize;
+	const int32 MaxRY = FMath::Min(ChangedCells.MaxY + 1, YCount - 1) / VersionRegionSize;
+
+	for (int32 RY = MinRY; RY <= MaxRY; RY++)
+	{
+		for (int32 RX = MinRX; RX <= MaxRX; RX++)
+		{
+			RegionVersions[RY * VersionRegionsX + RX] = GridVersion;
+		}
+	}
+}
+
+uint32 AGAGridActor::GetRegionVersion(const FCellRef& CellRef) const
+{
+	const int32 RegionIndex = (CellRef.Y / VersionRegionSize) * VersionRegionsX + (CellRef.X / VersionRegionSize);
+	return RegionVersions.IsValidIndex(RegionIndex) ? RegionVersions[RegionIndex] : GridVersion;
+}
+
+uint32 AGAGridActor::GetBoxVersion(const FGridBox& Box) const
+{
+	if (RegionVersions.Num() == 0)
+	{
+		return GridVersion;
+	}
+
+	const int32 RegionsY = RegionVersions.Num() / VersionRegionsX;
+	const int32 MinRX = FMath::Clamp(Box.MinX / VersionRegionSize, 0, VersionRegionsX - 1);
+	const int32 MaxRX = FMath::Clamp(Box.MaxX / VersionRegionSize, 0, VersionRegionsX - 1);
+	const int32 MinRY = FMath::Clamp(Box.MinY / VersionRegionSize, 0, RegionsY - 1);
+	const int32 MaxRY = FMath::Clamp(Box.MaxY / VersionRegionSize, 0, RegionsY - 1);
+
+	uint32 Result = 0;
+	for (int32 RY = MinRY; RY <= MaxRY; RY++)
+	{
+		for (int32 RX = MinRX; RX <= MaxRX; RX++)
+		{
+			Result = FMath::Max(Result, RegionVersions[RY * VersionRegionsX + RX]);
+		}
+	}
 	return Result;
 }
 
 
+void AGAGridActor::RefreshClearance()
+{
+	Clearance.SetNumUninitialized(XCount * YCount);
+	uint8* Values = Clearance.GetData();
+
+	// Anything off the grid counts as blocked
+	auto Get = [this, Values](int32 X, int32 Y) -> int32
+	{
+		return ((X < 0) || (Y < 0) || (X >= XCount) || (Y >= YCount)) ? 0 : Values[Y * XCount + X];
+	};
+
+	// Brushfire in two sweeps. Forwards, each cell takes one more than the smallest of the four neighbours we've
+	// already visited, (X-1, Y), (X-1, Y-1), (X, Y-1) and (X+1, Y-1). Then backwards, the same with the other four.
+	// Two sweeps are enough to be exact for this (max of |DX|, |DY|) distance.
+	for (int32 Y = 0; Y < YCount; Y++)
+	{
+		for (int32 X = 0; X < XCount; X++)
+		{
+			if (!TraversableBits.Get(X, Y))
+			{
+				Values[Y * XCount + X] = 0;
+				continue;
+			}
+			const int32 Nearest = FMath::Min(FMath::Min(Get(X - 1, Y), Get(X - 1, Y - 1)), FMath::Min(Get(X, Y - 1), Get(X + 1, Y - 1)));
+			Values[Y * XCount + X] = uint8(FMath::Min(Nearest + 1, 255));
+		}
+	}
+
+	for (int32 Y = YCount - 1; Y >= 0; Y--)
+	{
+		for (int32 X = XCount - 1; X >= 0; X--)
+		{
+			uint8& Value = Values[Y * XCount + X];
+			if (Value == 0)
+			{
+				continue;
+			}
+			const int32 Nearest = FMath::Min(FMath::Min(Get(X + 1, Y), Get(X + 1, Y + 1)), FMath::Min(Get(X, Y + 1), Get(X - 1, Y + 1)));
+			Value = uint8(FMath::Min(int32(Value), Nearest + 1));
+		}
+	}
+}
+
+
+// A run of traversable cells in one row, for the component labelling
+struct FComponentRun
+{
+	int32 Y;
+	int32 MinX;
+	int32 MaxX;
+};
+
+static int32 FindRoot(TArray<int32>& Parents, int32 Index)
+{
+	while (Parents[Index] != Index)
+	{
+		// Path halving
+		Parents[Index] = Parents[Parents[Index]];
+		Index = Parents[Index];
+	}
+	return Index;
+}
+
+static void UnionRuns(TArray<int32>& Parents, int32 A, int32 B)
+{
+	A = FindRoot(Parents, A);
+	B = FindRoot(Parents, B);
+	if (A != B)
+	{
+		// Lower index wins, which keeps labels in scan order
+		Parents[FMath::Max(A, B)] = FMath::Min(A, B);
+	}
+}
+
+void AGAGridActor::RefreshComponents()
+{
+	// Union-find over runs rather than cells, since the bit plane hands us whole runs at a time
+	TArray<FComponentRun> Runs;
+	TArray<int32> Parents;
+	int32 PrevRowStart = 0;
+
+	for (int32 Y = 0; Y < YCount; Y++)
+	{
+		const int32 RowStart = Runs.Num();
+
+		int32 X = TraversableBits.FindFirstSetInSpan(Y, 0, XCount - 1);
+		while (X != INDEX_NONE)
+		{
+			const int32 NextClear = TraversableBits.FindFirstClearInSpan(Y, X, XCount - 1);
+			const int32 MaxX = (NextClear == INDEX_NONE) ? XCount - 1 : NextClear - 1;
+
+			const int32 RunIndex = Runs.Add(FComponentRun{ Y, X, MaxX });
+			Parents.Add(RunIndex);
+
+			X = (MaxX + 1 < XCount) ? TraversableBits.FindFirstSetInSpan(Y, MaxX + 1, XCount - 1) : INDEX_NONE;
+		}
+
+		// Join up with every run in the row below that overlaps. Both rows are sorted, so walk them together.
+		int32 Prev = PrevRowStart;
+		for (int32 Cur = RowStart; (Cur < Runs.Num()) && (Prev < RowStart); )
+		{
+			const FComponentRun& A = Runs[Prev];
+			const FComponentRun& B = Runs[Cur];
+			if ((A.MinX <= B.MaxX) && (B.MinX <= A.MaxX))
+			{
+				UnionRuns(Parents, Prev, Cur);
+			}
+
+			// Step whichever run ends first
+			if (A.MaxX < B.MaxX)
+			{
+				Prev++;
+			}
+			else
+			{
+				Cur++;
+			}
+		}
+
+		PrevRowStart = RowStart;
+	}
+
+	// Number the roots 1, 2, 3... and paint the labels in
+	ComponentLabels.SetNumUninitialized(XCount * YCount);
+	FMemory::Memzero(ComponentLabels.GetData(), ComponentLabels.Num() * sizeof(int32));
+
+	TArray<int32> RootLabels;
+	RootLabels.SetNumZeroed(Runs.Num());
+	ComponentCount = 0;
+
+	for (int32 RunIndex = 0; RunIndex < Runs.Num(); RunIndex++)
+	{
+		const int32 Root = FindRoot(Parents, RunIndex);
+		if (RootLabels[Root] == 0)
+		{
+			RootLabels[Root] = ++ComponentCount;
+		}
+
+		const FComponentRun& Run = Runs[RunIndex];
+		int32* Row = ComponentLabels.GetData() + Run.Y * XCount;
+		for (int32 X = Run.MinX; X <= Run.MaxX; X++)
+		{
+			Row[X] = RootLabels[Root];
+		}
+	}
+}
+
+
+uint8 AGAGridActor::GetClearanceForRadius(float AgentRadius) const
+{
+	// Clearance C leaves (C - 0.5) cells of room either side of the cell centre
+	return uint8(FMath::Clamp(FMath::CeilToInt32(AgentRadius / CellScale + 0.5f), 1, 255));
+}
+
+
+TSharedRef<const FGAGridSnapshot, ESPMode::ThreadSafe> AGAGridActor::GetSnapshot() const
+{
+	if (!Snapshot.IsValid() || (Snapshot->GridVersion != GridVersion))
+	{
+		TSharedRef<FGAGridSnapshot, ESPMode::ThreadSafe> NewSnapshot = MakeShared<FGAGridSnapshot, ESPMode::ThreadSafe>();
+		NewSnapshot->Traversable = TraversableBits;
+		NewSnapshot->Clearance = Clearance;
+		NewSnapshot->GridVersion = GridVersion;
+		Snapshot = NewSnapshot;
+	}
+	return Snapshot.ToSharedRef();
+}
+
+
 // Debugging and Visualization --------------------------------
 
 
@@ -472,33 +1179,59 @@ bool AGAGridActor::RefreshDebugTexture()
 			float MaxValue;
 			DebugGridMap.GetMaxValue(MaxValue);
 
+			// Everything off the map first
 			for (int32 Y = 0; Y < YCount; Y++)
 			{
 				for (int32 X = 0; X < XCount; X++)
 				{
-					FCellRef CellRef(X, Y);
-					ECellData CellData = GetCellData(CellRef);
+					ECellData CellData = GetCellData(FCellRef(X, Y));
 					bool Traversable = EnumHasAllFlags(CellData, ECellData::CellDataTraversable);
 
-					float MapValue;
-					bool IsOnMap = DebugGridMap.GetValue(CellRef, MapValue);
-					int32 IntVal = 0;
-					if (IsOnMap)
-					{
-						IntVal = FMath::RoundToInt(255.0f * (MapValue / MaxValue));
-					}
-
-					// Note: fade from blue to red as we approach the max value in the debug map
-
-					RawImageData[Index] = IsOnMap ? 255 - IntVal : 0;		// blue		Are we on the map or not?
+					RawImageData[Index] = 0;								// blue		Are we on the map or not?
 					RawImageData[Index + 1] = Traversable ? 50 : 0;			// green	Are we traversable or not?
-					RawImageData[Index + 2] = IntVal;						// red		The value
+					RawImageData[Index + 2] = 0;							// red		The value
 					RawImageData[Index + 3] = 255;							// alpha
 
 					Index += 4;
 				}
 			}
 
+			// Then just the map's own box, a row at a time. The map's often packed (see SetStorage), and this way we only
+			// unpack the cells it covers, rather than the whole thing per cell.
+			const FGridBox& Box = DebugGridMap.GridBounds;
+			const int32 Width = Box.GetWidth();
+			TArray<float> RowValues;
+			RowValues.SetNumUninitialized(Width);
+
+			// Clipped to the grid, in case the map was made for a different one
+			const int32 MinX = FMath::Max(Box.MinX, 0);
+			const int32 MaxX = FMath::Min(Box.MaxX, XCount - 1);
+			for (int32 Y = FMath::Max(Box.MinY, 0); Y <= FMath::Min(Box.MaxY, YCount - 1); Y++)
+			{
+				const int32 LocalY = Y - Box.MinY;
+				if (DebugGridMap.Layout == GAML_Linear)
+				{
+					DebugGridMap.UnpackValues(DebugGridMap.LocalToIndex(0, LocalY), Width, RowValues.GetData());
+				}
+				else
+				{
+					for (int32 LocalX = 0; LocalX < Width; LocalX++)
+					{
+						RowValues[LocalX] = DebugGridMap.GetValueAtIndex(DebugGridMap.LocalToIndex(LocalX, LocalY));
+					}
+				}
+
+				uint8* Pixel = RawImageData + 4 * (Y * XCount + MinX);
+				for (int32 LocalX = MinX - Box.MinX; LocalX <= MaxX - Box.MinX; LocalX++, Pixel += 4)
+				{
+					// Note: fade from blue to red as we approach the max value in the debug map
+					// Clamp, since masked out cells can be -FLT_MAX
+					const int32 IntVal = FMath::RoundToInt(255.0f * FMath::Clamp(RowValues[LocalX] / MaxValue, 0.0f, 1.0f));
+					Pixel[0] = 255 - IntVal;
+					Pixel[2] = IntVal;
+				}
+			}
+
 		}
 		else
 		{
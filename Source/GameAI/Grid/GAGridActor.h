@@ -3,12 +3,19 @@
 #include "CoreMinimal.h"
 #include "Math/MathFwd.h"
 #include "GAGridMap.h"
+#include "GAGridBitPlane.h"
+#include "GAJumpPointTable.h"
+#include "GAHierarchicalGraph.h"
+#include "GAVisibilitySet.h"
 #include "GAGridActor.generated.h"
 
 class UBoxComponent;
 class USceneComponent;
 class UProceduralMeshComponent;
 class UTexture2D;
+class ANavigationData;
+class ARecastNavMesh;
+struct FGAVisibilityField;
 
 UENUM(BlueprintType, meta = (Bitflags, UseEnumValuesAsMaskValuesInEditor = "true"))
 enum class ECellData : uint8
@@ -18,6 +25,19 @@ enum class ECellData : uint8
 };
 ENUM_CLASS_FLAGS(ECellData);
 
+// Broadcast whenever the cells in the given box change (the box covers the whole grid after a full refresh)
+DECLARE_MULTICAST_DELEGATE_OneParam(FGAOnGridCellsChanged, const FGridBox&);
+
+
+// A frozen copy of the grid's traversability, for searches running off the game thread
+// Nothing in here changes once it's made, so any number of worker threads can read it at once.
+struct FGAGridSnapshot
+{
+	FGAGridBitPlane Traversable;
+	TArray<uint8> Clearance;
+	uint32 GridVersion = 0;
+};
+
 
 USTRUCT(BlueprintType)
 struct FCellRef
@@ -93,6 +113,10 @@ class AGAGridActor : public AActor
 
 	virtual void PostLoad() override;
 
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 #if WITH_EDITORONLY_DATA
 	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
 	void RefreshBoxComponent();
@@ -130,6 +154,26 @@ public:
 	// where HalfExtents is 0.5 the total width and height of the grid
 	FVector2D GetCellGridSpacePosition(const FCellRef& CellRef) const;
 
+	// Get the grid-space position of a world point (dropping Z)
+	FVector2D GetGridSpacePosition(const FVector& Point) const;
+
+	// Line of sight across the grid: true if every cell between the two points is traversable
+	// Much cheaper than a physics trace, and deterministic, but only as good as the grid -- it knows nothing about
+	// height, or anything too thin to block a cell. See FGAGridBitPlane::IsLineClear.
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	bool HasGridLineOfSight(const FVector& From, const FVector& To) const;
+
+	// Grid line of sight from every cell of the box to Origin at once (centre to centre), by shadowcasting out from Origin
+	// Visits each cell of the box about once, so it's linear in the box's area. That beats a HasGridLineOfSight per cell
+	// as soon as more than a few cells look at the same place, but it's not free -- hang on to it while it IsValidFor.
+	bool BuildVisibilityField(const FCellRef& Origin, const FGridBox& Box, FGAVisibilityField& FieldOut) const;
+
+	// Grid line of sight between two cell centres
+	// Tries the baked visibility set first (see bBuildVisibilitySet), which settles it outright when it's exact
+	// or when the two clusters can't see each other at all. Otherwise walks the line.
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	bool HasCellLineOfSight(const FCellRef& A, const FCellRef& B) const;
+
 
 	// Return the flattened index of the cell
 	// The assumes a X-major ordering of the data array.
@@ -143,6 +187,13 @@ public:
 	UFUNCTION(BlueprintCallable)
 	ECellData GetCellData(const FCellRef &CellRef) const;
 
+	// Is the given cell traversable? Unlike GetCellData, this is safe to call with cells outside the grid (they're not traversable)
+	// Note: this reads the packed traversability bits, which are only brought up to date by RefreshDerivedData
+	FORCEINLINE bool IsTraversable(int32 X, int32 Y) const
+	{
+		return TraversableBits.Get(X, Y);
+	}
+
 	// Returns the bounds of the given box in cell indices
 	// Note, assumes the Box is in grid-space already
 	// Returns an invalid rectangle if the Box and the grid are disjoint
@@ -154,6 +205,185 @@ public:
 	UFUNCTION(BlueprintCallable)
 	bool RefreshDataFromNav();
 
+	// Should we listen for the navmesh being rebuilt at runtime, and patch up the cells under the tiles that changed?
+	// Only does anything if the project uses dynamic navmesh generation.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	bool bRefreshOnNavUpdates;
+
+private:
+	UFUNCTION()
+	void OnNavigationGenerationFinished(ANavigationData* NavData);
+
+	// What we last saw of each nav tile slot, so we can tell which tiles changed when the navmesh is rebuilt
+	struct FNavTileState
+	{
+		uint32 Salt = 0;				// Detour bumps a tile slot's salt every time the tile in it is replaced or removed
+		FIntRect CellRect;				// The cells under the tile
+		bool bHasCells = false;
+	};
+
+	TArray<FNavTileState> NavTileStates;
+
+	// Record the current state of the nav tiles. If DirtyRectsOut is given, it gets the cells under every tile
+	// that changed since last time -- both where the old tile was and where the new one is.
+	void UpdateNavTileStates(const ARecastNavMesh* NavMesh, TArray<FIntRect>* DirtyRectsOut);
+
+	// Clear the given cells and re-rasterize them from the tiles that overlap them
+	void RefreshDataFromNavInRects(const ARecastNavMesh* NavMesh, const TArray<FIntRect>& DirtyRects);
+
+	// The cells under the given nav tile, false if it doesn't overlap the grid
+	bool GetNavTileCellRect(const ARecastNavMesh* NavMesh, int32 TileIndex, FIntRect& RectOut) const;
+
+public:
+
+	// Derived Data --------------------------------
+
+	// Rebuild everything we compute from Data (e.g. the jump point table)
+	// This is done automatically after RefreshDataFromNav and on load, but call it if you modify Data yourself
+	UFUNCTION(BlueprintCallable)
+	void RefreshDerivedData();
+
+	// Same as RefreshDerivedData, but when only the cells in the given box have changed
+	// Anything that can be patched up locally (e.g. the hierarchy clusters) only rebuilds the parts near the box.
+	UFUNCTION(BlueprintCallable)
+	void RefreshDerivedDataInBox(const FGridBox& ChangedCells);
+
+	// Should we precompute the JPS+ jump distances? Costs 16 bytes per cell.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	bool bBuildJumpPointTable;
+
+	// Should we build the HPA* cluster graph? Only really worth it on big grids.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	bool bBuildHierarchy;
+
+	// Width and height of an HPA* cluster, in cells
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (ClampMin = 4))
+	int32 HierarchyClusterSize;
+
+	// Should we bake a potentially-visible set between clusters of cells? Only for grids that don't change at runtime:
+	// a runtime change just throws it away (LOS falls back to walking lines) since re-baking is far too slow.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly)
+	bool bBuildVisibilitySet;
+
+	// Width and height of a visibility set cluster, in cells. 1 gives exact answers; memory falls with the square of this.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (ClampMin = 1))
+	int32 VisibilitySetClusterSize;
+
+	// The traversable bit of every cell, packed 64 to a word. Use this for anything that wants to test runs of cells at once.
+	const FGAGridBitPlane& GetTraversableBits() const { return TraversableBits; }
+
+	// Clearance --------------------------------
+	// How far each cell is from the nearest blocked cell (or the edge of the grid), in cells, measured as the larger
+	// of the X and Y offsets. 0 for blocked cells, 1 for traversable cells next to something blocked, and so on, up to 255.
+	// A cell with clearance C has a clear square of (2C - 1) cells on a side centred on it.
+	// Searches take a minimum clearance (see FGAGridSearch::SetMinClearance), so agents of any size can share the grid.
+
+	FORCEINLINE uint8 GetClearance(int32 X, int32 Y) const
+	{
+		if ((X < 0) || (Y < 0) || (X >= XCount) || (Y >= YCount) || (Clearance.Num() != XCount * YCount))
+		{
+			return 0;
+		}
+		return Clearance[Y * XCount + X];
+	}
+
+	const TArray<uint8>& GetClearanceField() const { return Clearance; }
+
+	// The clearance a cell needs for an agent of the given radius, standing at its centre, to fit
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	uint8 GetClearanceForRadius(float AgentRadius) const;
+
+	// Connected components --------------------------------
+	// Every traversable cell is labelled with the region it belongs to: two cells have the same label exactly when
+	// there's a path between them. Blocked cells (and anything off the grid) are 0. Since diagonal steps can't cut
+	// corners, this is just 4-connectivity.
+	// So a query for a goal in another region can fail straight away, instead of searching everything it can reach first.
+
+	FORCEINLINE int32 GetComponent(int32 X, int32 Y) const
+	{
+		if ((X < 0) || (Y < 0) || (X >= XCount) || (Y >= YCount) || (ComponentLabels.Num() != XCount * YCount))
+		{
+			return 0;
+		}
+		return ComponentLabels[Y * XCount + X];
+	}
+
+	FORCEINLINE int32 GetComponent(const FCellRef& CellRef) const { return GetComponent(CellRef.X, CellRef.Y); }
+
+	// Is there any path at all from A to B? (Ignoring clearance -- if this says no, no agent can make it.)
+	UFUNCTION(BlueprintCallable, BlueprintPure)
+	bool AreConnected(const FCellRef& A, const FCellRef& B) const
+	{
+		const int32 Component = GetComponent(A);
+		return (Component != 0) && (Component == GetComponent(B));
+	}
+
+	int32 GetComponentCount() const { return ComponentCount; }
+
+	const FGAJumpPointTable& GetJumpPointTable() const { return JumpPointTable; }
+
+	const FGAHierarchicalGraph& GetHierarchicalGraph() const { return HierarchicalGraph; }
+
+	const FGAVisibilitySet& GetVisibilitySet() const { return VisibilitySet; }
+
+	// Versions --------------------------------
+	// Anything that caches results computed from the grid (paths, fields, etc.) can hang on to a version number
+	// and compare it later to see if the data it was built from has changed. Every change to the cells bumps the
+	// global version, and stamps the regions it touched with the new value. So the version of a box only changes
+	// when cells near that box do.
+
+	// Width and height of a version region, in cells
+	static constexpr int32 VersionRegionSize = 32;
+
+	uint32 GetGridVersion() const { return GridVersion; }
+
+	uint32 GetRegionVersion(const FCellRef& CellRef) const;
+
+	// The latest version of any region overlapping the box
+	uint32 GetBoxVersion(const FGridBox& Box) const;
+
+	FGAOnGridCellsChanged OnCellsChanged;
+
+	// A read-only snapshot of the current traversability. Shared until the grid next changes, so asking for it
+	// every query is cheap.
+	TSharedRef<const FGAGridSnapshot, ESPMode::ThreadSafe> GetSnapshot() const;
+
+private:
+	void BumpVersions(const FGridBox& ChangedCells);
+
+	uint32 GridVersion = 0;
+
+	int32 VersionRegionsX = 0;
+
+	TArray<uint32> RegionVersions;
+
+	mutable TSharedPtr<const FGAGridSnapshot, ESPMode::ThreadSafe> Snapshot;
+
+	// Copy the traversable bits of the given rows out of Data
+	void RefreshTraversableBits(int32 MinY, int32 MaxY);
+
+	FGAGridBitPlane TraversableBits;
+
+	// Rebuild the clearance field from the traversable bits
+	void RefreshClearance();
+
+	TArray<uint8> Clearance;
+
+	// Relabel the connected components from the traversable bits
+	void RefreshComponents();
+
+	TArray<int32> ComponentLabels;
+
+	int32 ComponentCount = 0;
+
+	FGAJumpPointTable JumpPointTable;
+
+	FGAHierarchicalGraph HierarchicalGraph;
+
+	FGAVisibilitySet VisibilitySet;
+
+public:
+
 	// Debugging and Visualization --------------------------------
 
 	UPROPERTY(EditAnywhere)
@@ -0,0 +1,259 @@
+#include "GAGridBitPlane.h"
+
+
+void FGAGridBitPlane::Init(int32 XCountIn, int32 YCountIn)
+{
+	XCount = FMath::Max(XCountIn, 0);
+	YCount = FMath::Max(YCountIn, 0);
+	WordsPerRow = FMath::DivideAndRoundUp(XCount, BitsPerWord);
+	Words.SetNumUninitialized(WordsPerRow * YCount);
+	FMemory::Memzero(Words.GetData(), Words.Num() * sizeof(uint64));
+}
+
+
+void FGAGridBitPlane::Empty()
+{
+	XCount = 0;
+	YCount = 0;
+	WordsPerRow = 0;
+	Words.Empty();
+}
+
+
+void FGAGridBitPlane::SetSpan(int32 Y, int32 MinX, int32 MaxX, bool bValue)
+{
+	if (!ClipSpan(Y, MinX, MaxX))
+	{
+		return;
+	}
+
+	uint64* Row = Words.GetData() + Y * WordsPerRow;
+	const int32 FirstWord = MinX >> 6;
+	const int32 LastWord = MaxX >> 6;
+
+	for (int32 WordIndex = FirstWord; WordIndex <= LastWord; WordIndex++)
+	{
+		const uint64 Mask = GetRangeMask((WordIndex == FirstWord) ? (MinX & 63) : 0, (WordIndex == LastWord) ? (MaxX & 63) : 63);
+		Row[WordIndex] = bValue ? (Row[WordIndex] | Mask) : (Row[WordIndex] & ~Mask);
+	}
+}
+
+
+int32 FGAGridBitPlane::CountSetInSpan(int32 Y, int32 MinX, int32 MaxX) const
+{
+	if (!ClipSpan(Y, MinX, MaxX))
+	{
+		return 0;
+	}
+
+	const uint64* Row = GetRow(Y);
+	const int32 FirstWord = MinX >> 6;
+	const int32 LastWord = MaxX >> 6;
+
+	int32 Result = 0;
+	for (int32 WordIndex = FirstWord; WordIndex <= LastWord; WordIndex++)
+	{
+		const uint64 Mask = GetRangeMask((WordIndex == FirstWord) ? (MinX & 63) : 0, (WordIndex == LastWord) ? (MaxX & 63) : 63);
+		Result += int32(FMath::CountBits(Row[WordIndex] & Mask));
+	}
+	return Result;
+}
+
+
+bool FGAGridBitPlane::AreAllSetInSpan(int32 Y, int32 MinX, int32 MaxX) const
+{
+	// Anything off the grid counts as clear
+	if ((MinX < 0) || (MaxX >= XCount) || !ClipSpan(Y, MinX, MaxX))
+	{
+		return false;
+	}
+
+	const uint64* Row = GetRow(Y);
+	const int32 FirstWord = MinX >> 6;
+	const int32 LastWord = MaxX >> 6;
+
+	for (int32 WordIndex = FirstWord; WordIndex <= LastWord; WordIndex++)
+	{
+		const uint64 Mask = GetRangeMask((WordIndex == FirstWord) ? (MinX & 63) : 0, (WordIndex == LastWord) ? (MaxX & 63) : 63);
+		if ((Row[WordIndex] & Mask) != Mask)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+int32 FGAGridBitPlane::FindFirstSetInSpan(int32 Y, int32 MinX, int32 MaxX) const
+{
+	if (!ClipSpan(Y, MinX, MaxX))
+	{
+		return INDEX_NONE;
+	}
+
+	const uint64* Row = GetRow(Y);
+	const int32 FirstWord = MinX >> 6;
+	const int32 LastWord = MaxX >> 6;
+
+	for (int32 WordIndex = FirstWord; WordIndex <= LastWord; WordIndex++)
+	{
+		const uint64 Mask = GetRangeMask((WordIndex == FirstWord) ? (MinX & 63) : 0, (WordIndex == LastWord) ? (MaxX & 63) : 63);
+		const uint64 Bits = Row[WordIndex] & Mask;
+		if (Bits != 0)
+		{
+			return WordIndex * BitsPerWord + int32(FMath::CountTrailingZeros64(Bits));
+		}
+	}
+	return INDEX_NONE;
+}
+
+
+int32 FGAGridBitPlane::FindFirstClearInSpan(int32 Y, int32 MinX, int32 MaxX) const
+{
+	if (!ClipSpan(Y, MinX, MaxX))
+	{
+		return INDEX_NONE;
+	}
+
+	const uint64* Row = GetRow(Y);
+	const int32 FirstWord = MinX >> 6;
+	const int32 LastWord = MaxX >> 6;
+
+	for (int32 WordIndex = FirstWord; WordIndex <= LastWord; WordIndex++)
+	{
+		const uint64 Mask = GetRangeMask((WordIndex == FirstWord) ? (MinX & 63) : 0, (WordIndex == LastWord) ? (MaxX & 63) : 63);
+		const uint64 Bits = ~Row[WordIndex] & Mask;
+		if (Bits != 0)
+		{
+			return WordIndex * BitsPerWord + int32(FMath::CountTrailingZeros64(Bits));
+		}
+	}
+	return INDEX_NONE;
+}
+
+
+bool FGAGridBitPlane::GetRunAt(int32 X, int32 Y, int32& MinXOut, int32& MaxXOut) const
+{
+	if (!Get(X, Y))
+	{
+		return false;
+	}
+
+	// Forwards is easy, the first clear cell after X ends the run
+	const int32 NextClear = FindFirstClearInSpan(Y, X, XCount - 1);
+	MaxXOut = (NextClear == INDEX_NONE) ? XCount - 1 : NextClear - 1;
+
+	// Backwards we walk the words by hand, looking for the highest clear bit below X
+	const uint64* Row = GetRow(Y);
+	MinXOut = 0;
+	for (int32 WordIndex = X >> 6; WordIndex >= 0; WordIndex--)
+	{
+		const uint64 Mask = GetRangeMask(0, (WordIndex == (X >> 6)) ? (X & 63) : 63);
+		const uint64 Bits = ~Row[WordIndex] & Mask;
+		if (Bits != 0)
+		{
+			MinXOut = WordIndex * BitsPerWord + (63 - int32(FMath::CountLeadingZeros64(Bits))) + 1;
+			break;
+		}
+	}
+
+	return true;
+}
+
+
+bool FGAGridBitPlane::IsLineClear(const FVector2D& From, const FVector2D& To) const
+{
+	int32 X = FMath::FloorToInt32(From.X);
+	int32 Y = FMath::FloorToInt32(From.Y);
+	const int32 EndX = FMath::FloorToInt32(To.X);
+	const int32 EndY = FMath::FloorToInt32(To.Y);
+
+	// Staying within one row is common (and the word queries do it 64 cells at a time)
+	if (Y == EndY)
+	{
+		return AreAllSetInSpan(Y, FMath::Min(X, EndX), FMath::Max(X, EndX));
+	}
+
+	if (!Get(X, Y))
+	{
+		return false;
+	}
+
+	const double DX = To.X - From.X;
+	const double DY = To.Y - From.Y;
+	const int32 StepX = (DX > 0.0) ? 1 : ((DX < 0.0) ? -1 : 0);
+	const int32 StepY = (DY > 0.0) ? 1 : ((DY < 0.0) ? -1 : 0);
+
+	// T runs from 0 at From to 1 at To. TMax is the T at which we cross the next cell boundary, TDelta how much T
+	// it takes to cross a whole cell.
+	const double TDeltaX = (StepX != 0) ? 1.0 / FMath::Abs(DX) : UE_BIG_NUMBER;
+	const double TDeltaY = (StepY != 0) ? 1.0 / FMath::Abs(DY) : UE_BIG_NUMBER;
+	double TMaxX = (StepX > 0) ? (double(X + 1) - From.X) / DX : ((StepX < 0) ? (From.X - double(X)) / -DX : UE_BIG_NUMBER);
+	double TMaxY = (StepY > 0) ? (double(Y + 1) - From.Y) / DY : ((StepY < 0) ? (From.Y - double(Y)) / -DY : UE_BIG_NUMBER);
+
+	// Near enough equal counts as going through the corner, otherwise rounding could let us slip past one side of it
+	constexpr double CornerTolerance = 1.0e-9;
+
+	// Counting the steps left, rather than testing for the end cell, means rounding can never make us overshoot forever
+	int32 StepsLeft = FMath::Abs(EndX - X) + FMath::Abs(EndY - Y);
+	while (StepsLeft > 0)
+	{
+		if (TMaxX < TMaxY - CornerTolerance)
+		{
+			X += StepX;
+			TMaxX += TDeltaX;
+			StepsLeft--;
+		}
+		else if (TMaxY < TMaxX - CornerTolerance)
+		{
+			Y += StepY;
+			TMaxY += TDeltaY;
+			StepsLeft--;
+		}
+		else
+		{
+			if (!Get(X + StepX, Y) || !Get(X, Y + StepY))
+			{
+				return false;
+			}
+			X += StepX;
+			Y += StepY;
+			TMaxX += TDeltaX;
+			TMaxY += TDeltaY;
+			StepsLeft -= 2;
+		}
+
+		if (!Get(X, Y))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
+int32 FGAGridBitPlane::CountSetInBox(const FGridBox& Box) const
+{
+	const int32 MinY = FMath::Max(Box.MinY, 0);
+	const int32 MaxY = FMath::Min(Box.MaxY, YCount - 1);
+
+	int32 Result = 0;
+	for (int32 Y = MinY; Y <= MaxY; Y++)
+	{
+		Result += CountSetInSpan(Y, Box.MinX, Box.MaxX);
+	}
+	return Result;
+}
+
+
+int32 FGAGridBitPlane::CountSet() const
+{
+	// Padding bits are always 0, so we can just count the lot
+	int32 Result = 0;
+	for (const uint64 Word : Words)
+	{
+		Result += int32(FMath::CountBits(Word));
+	}
+	return Result;
+}
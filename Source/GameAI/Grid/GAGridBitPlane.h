@@ -0,0 +1,114 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GAGridMap.h"
+
+
+// One bit per cell over a grid, packed into 64-bit words
+// Each row starts on a fresh word, so a row is WordsPerRow words with bit (X % 64) of word (X / 64) holding cell X.
+// The padding bits past XCount at the end of each row are always 0, and anything outside the grid reads as 0,
+// so callers never have to special-case the edges.
+//
+// AGAGridActor keeps one of these in sync with the traversable bit of its Data. Besides being an eighth of the size,
+// the word-level queries below test 64 cells at a time, which is what the searches and line of sight tests want.
+
+class FGAGridBitPlane
+{
+public:
+	static constexpr int32 BitsPerWord = 64;
+
+	void Init(int32 XCountIn, int32 YCountIn);
+
+	void Empty();
+
+	bool IsValidFor(int32 XCountIn, int32 YCountIn) const
+	{
+		return (XCount == XCountIn) && (YCount == YCountIn) && (Words.Num() == WordsPerRow * YCount);
+	}
+
+	int32 GetXCount() const { return XCount; }
+	int32 GetYCount() const { return YCount; }
+	int32 GetWordsPerRow() const { return WordsPerRow; }
+
+	FORCEINLINE bool Get(int32 X, int32 Y) const
+	{
+		if ((X < 0) || (Y < 0) || (X >= XCount) || (Y >= YCount))
+		{
+			return false;
+		}
+		return (Words[Y * WordsPerRow + (X >> 6)] >> (X & 63)) & 1;
+	}
+
+	FORCEINLINE void Set(int32 X, int32 Y, bool bValue)
+	{
+		check((X >= 0) && (Y >= 0) && (X < XCount) && (Y < YCount));
+		uint64& Word = Words[Y * WordsPerRow + (X >> 6)];
+		const uint64 Mask = uint64(1) << (X & 63);
+		Word = bValue ? (Word | Mask) : (Word & ~Mask);
+	}
+
+	// Set the bits of cells MinX..MaxX (inclusive) of row Y
+	void SetSpan(int32 Y, int32 MinX, int32 MaxX, bool bValue);
+
+	// The words of row Y, WordsPerRow of them
+	FORCEINLINE const uint64* GetRow(int32 Y) const { return Words.GetData() + Y * WordsPerRow; }
+
+	// Row queries --------------------------------
+	// These all take an inclusive range of cells in one row, and clip it to the grid.
+
+	// Number of set cells in the range
+	int32 CountSetInSpan(int32 Y, int32 MinX, int32 MaxX) const;
+
+	// Are all the cells in the range set? (false if the range is empty, or falls off the grid)
+	bool AreAllSetInSpan(int32 Y, int32 MinX, int32 MaxX) const;
+
+	// Is any cell in the range clear? i.e. "is anything blocked between here and there"
+	bool IsAnyClearInSpan(int32 Y, int32 MinX, int32 MaxX) const { return !AreAllSetInSpan(Y, MinX, MaxX); }
+
+	// First set / clear cell in the range, or INDEX_NONE
+	int32 FindFirstSetInSpan(int32 Y, int32 MinX, int32 MaxX) const;
+	int32 FindFirstClearInSpan(int32 Y, int32 MinX, int32 MaxX) const;
+
+	// The run of set cells in row Y that contains X. False if X itself is clear.
+	bool GetRunAt(int32 X, int32 Y, int32& MinXOut, int32& MaxXOut) const;
+
+	// Line queries --------------------------------
+
+	// Is every cell the segment From-To passes through set? From and To are in cells, i.e. cell (X, Y) covers
+	// [X, X + 1) x [Y, Y + 1), so a cell's centre is (X + 0.5, Y + 0.5).
+	// Walks the cells with an Amanatides-Woo DDA. A segment passing exactly through a corner needs both of the cells
+	// either side of it to be set, so sight can't squeeze between two diagonal blockers.
+	bool IsLineClear(const FVector2D& From, const FVector2D& To) const;
+
+	// Box queries --------------------------------
+
+	// Number of set cells in the box. Handy as a cheap upper bound on how much of an area can be reached.
+	int32 CountSetInBox(const FGridBox& Box) const;
+
+	// Number of set cells on the whole grid
+	int32 CountSet() const;
+
+	SIZE_T GetAllocatedSize() const { return Words.GetAllocatedSize(); }
+
+private:
+	// Mask of bits From..To (inclusive) of a word
+	static FORCEINLINE uint64 GetRangeMask(int32 From, int32 To)
+	{
+		const uint64 High = (To == 63) ? ~uint64(0) : ((uint64(1) << (To + 1)) - 1);
+		return High & (~uint64(0) << From);
+	}
+
+	// Clip an inclusive span of row Y to the grid, false if nothing is left
+	bool ClipSpan(int32 Y, int32& MinX, int32& MaxX) const
+	{
+		MinX = FMath::Max(MinX, 0);
+		MaxX = FMath::Min(MaxX, XCount - 1);
+		return (Y >= 0) && (Y < YCount) && (MinX <= MaxX);
+	}
+
+	int32 XCount = 0;
+	int32 YCount = 0;
+	int32 WordsPerRow = 0;
+
+	TArray<uint64> Words;
+};
@@ -1,7 +1,6 @@
 #include "GAGridMap.h"
 #include "GAGridActor.h"
-
-UE_DISABLE_OPTIMIZATION
+#include "HAL/IConsoleManager.h"
 
 // --------------------- FGridBox ---------------------
 
@@ -13,7 +12,7 @@ bool FGridBox::IsValidCell(const FCellRef& Cell) const
 
 // --------------------- FGAGridMap ---------------------
 
-FGAGridMap::FGAGridMap() : XCount(INDEX_NONE), YCount(INDEX_NONE), GridBounds()
+FGAGridMap::FGAGridMap() : XCount(INDEX_NONE), YCount(INDEX_NONE), GridBounds(), Layout(GAML_Linear)
 {
 	// we are empty
 }
@@ -24,6 +23,7 @@ FGAGridMap::FGAGridMap(int32 XCountIn, int32 YCountIn, float InitialValue)
 	XCount = XCountIn;
 	YCount = YCountIn;
 	GridBounds = FGridBox(0, XCount - 1, 0, YCount - 1);
+	Layout = GAML_Linear;
 
 	ResetData(InitialValue);
 }
@@ -33,21 +33,26 @@ FGAGridMap::FGAGridMap(const AGAGridActor* Grid, float InitialValue)
 	XCount = Grid->XCount;
 	YCount = Grid->YCount;
 	GridBounds = FGridBox(0, XCount - 1, 0, YCount - 1);
+	Layout = GAML_Linear;
 
 	ResetData(InitialValue);
 }
 
-FGAGridMap::FGAGridMap(const AGAGridActor* Grid, const FGridBox& GridBoxIn, float InitialValue)
+FGAGridMap::FGAGridMap(const AGAGridActor* Grid, const FGridBox& GridBoxIn, float InitialValue, EGAGridMapLayout LayoutIn)
 {
 	XCount = Grid->XCount;
 	YCount = Grid->YCount;
 	GridBounds = GridBoxIn;
+	Layout = LayoutIn;
 
 	ResetData(InitialValue);
 }
 
 void FGAGridMap::ResetData(float InitialValue)
 {
+	Storage = GAMS_Float;
+	PackedData.Empty();
+
 	if (GridBounds.IsValid())
 	{
 		int32 BoxWidth = GridBounds.GetWidth();
@@ -56,13 +61,9 @@ void FGAGridMap::ResetData(float InitialValue)
 		check(BoxWidth > 0);
 		check(BoxHeight > 0);
 
-		int32 CellCount = BoxWidth * BoxHeight;
-		Data.SetNum(CellCount);
-
-		for (int32 Index = 0; Index < CellCount; Index++)
-		{
-			Data[Index] = InitialValue;
-		}
+		// Note: when tiled, this fills the padding too, which is harmless
+		Data.SetNumUninitialized(GetStorageCount());
+		Fill(InitialValue);
 	}
 	else
 	{
@@ -71,6 +72,45 @@ void FGAGridMap::ResetData(float InitialValue)
 }
 
 
+void FGAGridMap::SetLayout(EGAGridMapLayout NewLayout)
+{
+	if (NewLayout == Layout)
+	{
+		return;
+	}
+
+	if (!IsValid())
+	{
+		Layout = NewLayout;
+		return;
+	}
+
+	if (Storage != GAMS_Float)
+	{
+		// Easiest to do this on floats
+		const EGAGridMapStorage OldStorage = Storage;
+		SetStorage(GAMS_Float);
+		SetLayout(NewLayout);
+		SetStorage(OldStorage);
+		return;
+	}
+
+	// Hang on to the old values, and copy them across cell by cell
+	FGAGridMap OldMap;
+	OldMap.GridBounds = GridBounds;
+	OldMap.Layout = Layout;
+	OldMap.Data = MoveTemp(Data);
+
+	Layout = NewLayout;
+	Data.SetNumZeroed(GetStorageCount());
+
+	OldMap.ForEachCell([this](int32 X, int32 Y, float Value)
+	{
+		Data[LocalToIndex(X, Y)] = Value;
+	});
+}
+
+
 bool FGAGridMap::CellRefToLocal(const FCellRef& Cell, int32& X, int32& Y) const
 {
 	if (IsValid() && GridBounds.IsValidCell(Cell))
@@ -99,22 +139,31 @@ bool FGAGridMap::GetValue(const FCellRef& Cell, float &ValueOut) const
 	int32 X, Y;
 	if (CellRefToLocal(Cell, X, Y))
 	{
-		int32 Index = GridBounds.GetWidth()* Y + X;
-		check(Data.IsValidIndex(Index));
-		ValueOut = Data[Index];
+		int32 Index = LocalToIndex(X, Y);
+		ValueOut = GetValueAtIndex(Index);
 		return true;
 	}
 	return false;
 }
 
-bool FGAGridMap::GetMaxValue(float& MaxValueOut) const
+bool FGAGridMap::SetValue(const FCellRef& Cell, float Value)
 {
-	if (IsValid())
+	int32 X, Y;
+	if (CellRefToLocal(Cell, X, Y))
 	{
-		MaxValueOut = -UE_MAX_FLT;
-		for (int32 Index = 0; Index < Data.Num(); Index++)
+		int32 Index = LocalToIndex(X, Y);
+		switch (Storage)
 		{
-			MaxValueOut = FMath::Max(MaxValueOut, Data[Index]);
+		case GAMS_Half:
+			FPlatformMath::StoreHalf(&PackedData[Index], Value);
+			break;
+		case GAMS_UInt16:
+			// Anything outside the range we were packed with gets clamped
+			PackedData[Index] = uint16(FMath::Clamp(FMath::RoundToInt32((Value - PackBias) / PackScale), 0, int32(MAX_uint16)));
+			break;
+		default:
+			Data[Index] = Value;
+			break;
 		}
 		return true;
 	}
@@ -122,18 +171,589 @@ bool FGAGridMap::GetMaxValue(float& MaxValueOut) const
 }
 
 
-bool FGAGridMap::SetValue(const FCellRef& Cell, float Value)
+void FGAGridMap::IndexToLocal(int32 Index, int32& X, int32& Y) const
+{
+	if (Layout == GAML_Tiled)
+	{
+		const int32 Tile = Index >> (2 * TileShift);
+		const int32 InTile = Index & (TileCellCount - 1);
+		X = ((Tile % GetTileCountX()) << TileShift) + (InTile & TileMask);
+		Y = ((Tile / GetTileCountX()) << TileShift) + (InTile >> TileShift);
+	}
+	else
+	{
+		X = Index % GridBounds.GetWidth();
+		Y = Index / GridBounds.GetWidth();
+	}
+}
+
+
+// --------------------- Kernels ---------------------
+
+// Each kernel does the bulk of the array in vectors of 4, two vectors per iteration to keep a couple of
+// independent operations in flight, then mops up the last few floats one at a time.
+// Note: VectorLoad/VectorStore don't require alignment, which matters since spans of a tiled map start anywhere.
+
+static constexpr int32 KernelStride = 8;
+
+static void FillKernel(float* Values, int32 Count, float Value)
+{
+	const VectorRegister4Float V = VectorSetFloat1(Value);
+	int32 Index = 0;
+	for (; Index + KernelStride <= Count; Index += KernelStride)
+	{
+		VectorStore(V, Values + Index);
+		VectorStore(V, Values + Index + 4);
+	}
+	for (; Index < Count; Index++)
+	{
+		Values[Index] = Value;
+	}
+}
+
+static void MinMaxKernel(const float* Values, int32 Count, float& MinInOut, float& MaxInOut)
+{
+	int32 Index = 0;
+	if (Count >= KernelStride)
+	{
+		VectorRegister4Float Min0 = VectorSetFloat1(MinInOut);
+		VectorRegister4Float Max0 = VectorSetFloat1(MaxInOut);
+		VectorRegister4Float Min1 = Min0;
+		VectorRegister4Float Max1 = Max0;
+
+		for (; Index + KernelStride <= Count; Index += KernelStride)
+		{
+			const VectorRegister4Float A = VectorLoad(Values + Index);
+			const VectorRegister4Float B = VectorLoad(Values + Index + 4);
+			Min0 = VectorMin(Min0, A);
+			Max0 = VectorMax(Max0, A);
+			Min1 = VectorMin(Min1, B);
+			Max1 = VectorMax(Max1, B);
+		}
+
+		float MinLanes[4];
+		float MaxLanes[4];
+		VectorStore(VectorMin(Min0, Min1), MinLanes);
+		VectorStore(VectorMax(Max0, Max1), MaxLanes);
+		for (int32 Lane = 0; Lane < 4; Lane++)
+		{
+			MinInOut = FMath::Min(MinInOut, MinLanes[Lane]);
+			MaxInOut = FMath::Max(MaxInOut, MaxLanes[Lane]);
+		}
+	}
+
+	for (; Index < Count; Index++)
+	{
+		MinInOut = FMath::Min(MinInOut, Values[Index]);
+		MaxInOut = FMath::Max(MaxInOut, Values[Index]);
+	}
+}
+
+// Index of the first value equal to Value, or INDEX_NONE
+static int32 FindKernel(const float* Values, int32 Count, float Value)
+{
+	const VectorRegister4Float V = VectorSetFloat1(Value);
+	int32 Index = 0;
+	for (; Index + 4 <= Count; Index += 4)
+	{
+		const int32 Mask = VectorMaskBits(VectorCompareEQ(VectorLoad(Values + Index), V));
+		if (Mask != 0)
+		{
+			return Index + int32(FMath::CountTrailingZeros(uint32(Mask)));
+		}
+	}
+	for (; Index < Count; Index++)
+	{
+		if (Values[Index] == Value)
+		{
+			return Index;
+		}
+	}
+	return INDEX_NONE;
+}
+
+// Values = Op(Values, Others), with VectorOp and ScalarOp being the same operation
+template<typename VectorOpType, typename ScalarOpType>
+static void BinaryKernel(float* Values, const float* Others, int32 Count, VectorOpType VectorOp, ScalarOpType ScalarOp)
+{
+	int32 Index = 0;
+	for (; Index + KernelStride <= Count; Index += KernelStride)
+	{
+		VectorStore(VectorOp(VectorLoad(Values + Index), VectorLoad(Others + Index)), Values + Index);
+		VectorStore(VectorOp(VectorLoad(Values + Index + 4), VectorLoad(Others + Index + 4)), Values + Index + 4);
+	}
+	for (; Index < Count; Index++)
+	{
+		Values[Index] = ScalarOp(Values[Index], Others[Index]);
+	}
+}
+
+// Values = Op(Values), with VectorOp and ScalarOp being the same operation
+template<typename VectorOpType, typename ScalarOpType>
+static void UnaryKernel(float* Values, int32 Count, VectorOpType VectorOp, ScalarOpType ScalarOp)
+{
+	int32 Index = 0;
+	for (; Index + KernelStride <= Count; Index += KernelStride)
+	{
+		VectorStore(VectorOp(VectorLoad(Values + Index)), Values + Index);
+		VectorStore(VectorOp(VectorLoad(Values + Index + 4)), Values + Index + 4);
+	}
+	for (; Index < Count; Index++)
+	{
+		Values[Index] = ScalarOp(Values[Index]);
+	}
+}
+
+
+void FGAGridMap::Fill(float Value)
+{
+	// Padding included, no harm in it
+	FillKernel(Data.GetData(), Data.Num(), Value);
+}
+
+
+bool FGAGridMap::GetMinMaxValue(float& MinValueOut, float& MaxValueOut) const
+{
+	if (!IsValid())
+	{
+		return false;
+	}
+
+	// Reductions have to skip the padding of a tiled map, hence the spans
+	float MinValue = UE_MAX_FLT;
+	float MaxValue = -UE_MAX_FLT;
+	ForEachValueSpan([&](int32 StartIndex, const float* Values, int32 Count)
+	{
+		MinMaxKernel(Values, Count, MinValue, MaxValue);
+	});
+
+	MinValueOut = MinValue;
+	MaxValueOut = MaxValue;
+	return true;
+}
+
+
+bool FGAGridMap::GetMaxValue(float& MaxValueOut) const
+{
+	float MinValue;
+	return GetMinMaxValue(MinValue, MaxValueOut);
+}
+
+
+bool FGAGridMap::GetMinValue(float& MinValueOut) const
 {
+	float MaxValue;
+	return GetMinMaxValue(MinValueOut, MaxValue);
+}
+
+
+bool FGAGridMap::GetArgMax(FCellRef& CellOut, float& MaxValueOut) const
+{
+	float MaxValue;
+	if (!GetMaxValue(MaxValue))
+	{
+		return false;
+	}
+
+	// Two passes (find the max, then find where it is) is still cheaper than tracking the index in the first pass
+	int32 FoundIndex = INDEX_NONE;
+	ForEachValueSpan([&](int32 StartIndex, const float* Values, int32 Count)
+	{
+		if (FoundIndex == INDEX_NONE)
+		{
+			const int32 SpanIndex = FindKernel(Values, Count, MaxValue);
+			FoundIndex = (SpanIndex != INDEX_NONE) ? StartIndex + SpanIndex : INDEX_NONE;
+		}
+	});
+
+	if (FoundIndex == INDEX_NONE)
+	{
+		// Only possible if the map is full of NaNs
+		return false;
+	}
+
 	int32 X, Y;
-	if (CellRefToLocal(Cell, X, Y))
+	IndexToLocal(FoundIndex, X, Y);
+	CellOut = FCellRef(X + GridBounds.MinX, Y + GridBounds.MinY);
+	MaxValueOut = MaxValue;
+	return true;
+}
+
+
+bool FGAGridMap::Combine(TArrayView<const float> LayerValues, EGAMapOp Op)
+{
+	if (!IsFloatValid() || (LayerValues.Num() != Data.Num()))
 	{
-		int32 Index = GridBounds.GetWidth()* Y + X;
-		check(Data.IsValidIndex(Index));
-		Data[Index] = Value;
-		return true;
+		return false;
 	}
-	return false;
+
+	float* Values = Data.GetData();
+	const float* Others = LayerValues.GetData();
+
+	switch (Op)
+	{
+	case EGAMapOp::Assign:
+		FMemory::Memcpy(Values, Others, Data.Num() * sizeof(float));
+		break;
+	case EGAMapOp::Add:
+		BinaryKernel(Values, Others, Data.Num(),
+			[](const VectorRegister4Float& A, const VectorRegister4Float& B) { return VectorAdd(A, B); },
+			[](float A, float B) { return A + B; });
+		break;
+	case EGAMapOp::Multiply:
+		BinaryKernel(Values, Others, Data.Num(),
+			[](const VectorRegister4Float& A, const VectorRegister4Float& B) { return VectorMultiply(A, B); },
+			[](float A, float B) { return A * B; });
+		break;
+	}
+	return true;
+}
+
+
+bool FGAGridMap::Combine(const FGAGridMap& Layer, EGAMapOp Op)
+{
+	return IsCompatible(Layer) && Combine(TArrayView<const float>(Layer.Data), Op);
+}
+
+
+bool FGAGridMap::CombineSparse(TArrayView<const FGASparseCell> LayerCells, EGAMapOp Op)
+{
+	if (!IsFloatValid())
+	{
+		return false;
+	}
+
+	// Note: scattered writes, so there's nothing to vectorize here. It's all about touching fewer cells.
+	float* Values = Data.GetData();
+	switch (Op)
+	{
+	case EGAMapOp::Assign:
+		for (const FGASparseCell& Cell : LayerCells)
+		{
+			Values[Cell.Index] = Cell.Value;
+		}
+		break;
+	case EGAMapOp::Add:
+		for (const FGASparseCell& Cell : LayerCells)
+		{
+			Values[Cell.Index] += Cell.Value;
+		}
+		break;
+	case EGAMapOp::Multiply:
+		for (const FGASparseCell& Cell : LayerCells)
+		{
+			Values[Cell.Index] *= Cell.Value;
+		}
+		break;
+	}
+	return true;
+}
+
+
+bool FGAGridMap::GetArgMaxSparse(TArrayView<const FGASparseCell> Cells, FCellRef& CellOut, float& MaxValueOut) const
+{
+	if (!IsValid() || (Cells.Num() == 0))
+	{
+		return false;
+	}
+
+	int32 BestIndex = Cells[0].Index;
+	float BestValue = GetValueAtIndex(BestIndex);
+	for (const FGASparseCell& Cell : Cells)
+	{
+		const float Value = GetValueAtIndex(Cell.Index);
+		if (Value > BestValue)
+		{
+			BestIndex = Cell.Index;
+			BestValue = Value;
+		}
+	}
+
+	int32 X, Y;
+	IndexToLocal(BestIndex, X, Y);
+	CellOut = FCellRef(X + GridBounds.MinX, Y + GridBounds.MinY);
+	MaxValueOut = BestValue;
+	return true;
+}
+
+
+bool FGAGridMap::Add(const FGAGridMap& Other)
+{
+	return Combine(Other, EGAMapOp::Add);
+}
+
+
+bool FGAGridMap::Multiply(const FGAGridMap& Other)
+{
+	return Combine(Other, EGAMapOp::Multiply);
+}
+
+
+void FGAGridMap::ScaleBias(float Scale, float Bias)
+{
+	const VectorRegister4Float VScale = VectorSetFloat1(Scale);
+	const VectorRegister4Float VBias = VectorSetFloat1(Bias);
+
+	UnaryKernel(Data.GetData(), Data.Num(),
+		[&](const VectorRegister4Float& A) { return VectorMultiplyAdd(A, VScale, VBias); },
+		[&](float A) { return A * Scale + Bias; });
+}
+
+
+void FGAGridMap::Clamp(float MinValue, float MaxValue)
+{
+	const VectorRegister4Float VMin = VectorSetFloat1(MinValue);
+	const VectorRegister4Float VMax = VectorSetFloat1(MaxValue);
+
+	UnaryKernel(Data.GetData(), Data.Num(),
+		[&](const VectorRegister4Float& A) { return VectorMin(VectorMax(A, VMin), VMax); },
+		[&](float A) { return FMath::Clamp(A, MinValue, MaxValue); });
+}
+
+
+bool FGAGridMap::Normalize()
+{
+	float MinValue, MaxValue;
+	if ((Storage != GAMS_Float) || !GetMinMaxValue(MinValue, MaxValue))
+	{
+		return false;
+	}
+
+	const float Range = MaxValue - MinValue;
+	if (Range > UE_SMALL_NUMBER)
+	{
+		ScaleBias(1.0f / Range, -MinValue / Range);
+	}
+	else
+	{
+		Fill(0.0f);
+	}
+	return true;
+}
+
+
+bool FGAGridMap::MaskWhereAtLeast(const FGAGridMap& Mask, float Threshold, float MaskedValue)
+{
+	if (!IsCompatible(Mask))
+	{
+		return false;
+	}
+
+	const VectorRegister4Float VThreshold = VectorSetFloat1(Threshold);
+	const VectorRegister4Float VMasked = VectorSetFloat1(MaskedValue);
+
+	BinaryKernel(Data.GetData(), Mask.Data.GetData(), Data.Num(),
+		[&](const VectorRegister4Float& A, const VectorRegister4Float& B) { return VectorSelect(VectorCompareGE(B, VThreshold), VMasked, A); },
+		[&](float A, float B) { return (B >= Threshold) ? MaskedValue : A; });
+	return true;
+}
+
+
+// --------------------- Storage ---------------------
+
+void FGAGridMap::SetStorage(EGAGridMapStorage NewStorage)
+{
+	if (NewStorage == Storage)
+	{
+		return;
+	}
+
+	if (!IsValid())
+	{
+		Storage = NewStorage;
+		return;
+	}
+
+	if ((Storage != GAMS_Float) && (NewStorage != GAMS_Float))
+	{
+		// One packed format to another, go via float
+		SetStorage(GAMS_Float);
+		SetStorage(NewStorage);
+		return;
+	}
+
+	const int32 Count = GetStorageCount();
+
+	if (NewStorage == GAMS_Float)
+	{
+		Data.SetNumUninitialized(Count);
+		UnpackValues(0, Count, Data.GetData());
+		Storage = GAMS_Float;
+		PackedData.Empty();
+		PackScale = 1.0f;
+		PackBias = 0.0f;
+		return;
+	}
+
+	// Pack
+	PackedData.SetNumUninitialized(Count);
+	const float* Values = Data.GetData();
+	uint16* Codes = PackedData.GetData();
+	int32 Index = 0;
+
+	if (NewStorage == GAMS_Half)
+	{
+		for (; Index + 4 <= Count; Index += 4)
+		{
+			FPlatformMath::VectorStoreHalf(Codes + Index, Values + Index);
+		}
+		for (; Index < Count; Index++)
+		{
+			FPlatformMath::StoreHalf(Codes + Index, Values[Index]);
+		}
+	}
+	else
+	{
+		// Spread the codes evenly over the range of the values
+		float MinValue, MaxValue;
+		GetMinMaxValue(MinValue, MaxValue);
+		const float Range = MaxValue - MinValue;
+		if (!FMath::IsFinite(Range))
+		{
+			// Can't spread 65536 steps over an infinite range (e.g. a distance map with FLT_MAX in it). Half can cope.
+			PackedData.Empty();
+			SetStorage(GAMS_Half);
+			return;
+		}
+
+		PackBias = MinValue;
+		PackScale = (Range > 0.0f) ? Range / float(MAX_uint16) : 1.0f;
+
+		// Normalize into 0..1 over the range, and let the engine clamp, round and narrow to 16 bits four at a time
+		const float InvRange = (Range > 0.0f) ? 1.0f / Range : 0.0f;
+		const VectorRegister4Float VInvRange = VectorSetFloat1(InvRange);
+		const VectorRegister4Float VBias = VectorSetFloat1(-MinValue * InvRange);
+
+		for (; Index + 4 <= Count; Index += 4)
+		{
+			VectorStoreURGBA16N(VectorMultiplyAdd(VectorLoad(Values + Index), VInvRange, VBias), Codes + Index);
+		}
+		for (; Index < Count; Index++)
+		{
+			Codes[Index] = uint16(FMath::Clamp((Values[Index] - MinValue) * InvRange, 0.0f, 1.0f) * float(MAX_uint16) + 0.5f);
+		}
+	}
+
+	Storage = NewStorage;
+	Data.Empty();
 }
 
 
-UE_DISABLE_OPTIMIZATION
+void FGAGridMap::UnpackValues(int32 StartIndex, int32 Count, float* ValuesOut) const
+{
+	if (Storage == GAMS_Float)
+	{
+		FMemory::Memcpy(ValuesOut, Data.GetData() + StartIndex, Count * sizeof(float));
+		return;
+	}
+
+	const uint16* Codes = PackedData.GetData() + StartIndex;
+	int32 Index = 0;
+
+	if (Storage == GAMS_Half)
+	{
+		for (; Index + 4 <= Count; Index += 4)
+		{
+			FPlatformMath::VectorLoadHalf(ValuesOut + Index, Codes + Index);
+		}
+		for (; Index < Count; Index++)
+		{
+			ValuesOut[Index] = FPlatformMath::LoadHalf(Codes + Index);
+		}
+		return;
+	}
+
+	// The engine widens to 0..1 (Code / 65535), so scale that back up over the whole range
+	const VectorRegister4Float VRange = VectorSetFloat1(PackScale * float(MAX_uint16));
+	const VectorRegister4Float VBias = VectorSetFloat1(PackBias);
+	for (; Index + 4 <= Count; Index += 4)
+	{
+		VectorStore(VectorMultiplyAdd(VectorLoadURGBA16N(Codes + Index), VRange, VBias), ValuesOut + Index);
+	}
+	for (; Index < Count; Index++)
+	{
+		ValuesOut[Index] = float(Codes[Index]) * PackScale + PackBias;
+	}
+}
+
+
+// --------------------- Layout benchmark ---------------------
+
+// Times some neighbourhood-heavy passes over a map in each layout
+// Usage: GameAI.BenchmarkGridMapLayouts [Size]
+
+static void BenchmarkGridMapLayouts(const TArray<FString>& Args)
+{
+	const int32 Size = (Args.Num() > 0) ? FMath::Clamp(FCString::Atoi(*Args[0]), 16, 8192) : 1024;
+	const int32 Repeats = 5;
+
+	for (EGAGridMapLayout TestLayout : { GAML_Linear, GAML_Tiled })
+	{
+		FGAGridMap Source(Size, Size, 0.0f);
+		Source.SetLayout(TestLayout);
+		FGAGridMap Dest = Source;
+
+		FRandomStream Random(1234);
+		Source.ForEachCell([&Random](int32 X, int32 Y, float& Value)
+		{
+			Value = Random.FRand();
+		});
+
+		// 3x3 box blur, each cell reading all its neighbours
+		double StartTime = FPlatformTime::Seconds();
+		for (int32 Repeat = 0; Repeat < Repeats; Repeat++)
+		{
+			for (int32 Y = 1; Y < Size - 1; Y++)
+			{
+				for (int32 X = 1; X < Size - 1; X++)
+				{
+					float Sum = 0.0f;
+					for (int32 DY = -1; DY <= 1; DY++)
+					{
+						for (int32 DX = -1; DX <= 1; DX++)
+						{
+							Sum += Source.Data[Source.LocalToIndex(X + DX, Y + DY)];
+						}
+					}
+					Dest.Data[Dest.LocalToIndex(X, Y)] = Sum * (1.0f / 9.0f);
+				}
+			}
+		}
+		const double BlurTime = (FPlatformTime::Seconds() - StartTime) * 1000.0 / Repeats;
+
+		// Propagate down each column, like the vertical pass of a distance transform
+		StartTime = FPlatformTime::Seconds();
+		for (int32 Repeat = 0; Repeat < Repeats; Repeat++)
+		{
+			for (int32 X = 0; X < Size; X++)
+			{
+				for (int32 Y = 1; Y < Size; Y++)
+				{
+					float& Value = Dest.Data[Dest.LocalToIndex(X, Y)];
+					Value = FMath::Max(Value, Dest.Data[Dest.LocalToIndex(X, Y - 1)] - 0.01f);
+				}
+			}
+		}
+		const double ColumnTime = (FPlatformTime::Seconds() - StartTime) * 1000.0 / Repeats;
+
+		// Memory order traversal
+		StartTime = FPlatformTime::Seconds();
+		float Total = 0.0f;
+		for (int32 Repeat = 0; Repeat < Repeats; Repeat++)
+		{
+			Dest.ForEachCell([&Total](int32 X, int32 Y, float Value)
+			{
+				Total += Value;
+			});
+		}
+		const double IterateTime = (FPlatformTime::Seconds() - StartTime) * 1000.0 / Repeats;
+
+		UE_LOG(LogTemp, Log, TEXT("GridMap %s %dx%d: 3x3 blur %.2f ms, column sweep %.2f ms, ForEachCell %.2f ms (checksum %f)"),
+			(TestLayout == GAML_Tiled) ? TEXT("tiled") : TEXT("linear"), Size, Size, BlurTime, ColumnTime, IterateTime, Total);
+	}
+}
+
+static FAutoConsoleCommand BenchmarkGridMapLayoutsCommand(
+	TEXT("GameAI.BenchmarkGridMapLayouts"),
+	TEXT("Time neighbourhood-heavy passes over FGAGridMap in the linear and tiled layouts. Optional arg: map size (default 1024)"),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkGridMapLayouts));
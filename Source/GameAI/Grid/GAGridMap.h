@@ -51,6 +51,50 @@ struct FGridBox
 };
 
 
+// How the values of an FGAGridMap are laid out in memory
+// Linear is plain rows, which is the natural fit for row-by-row passes. Tiled stores the map as 8x8 blocks of cells
+// (each block is 64 contiguous floats, rows of 8), so that a cell and all its neighbours are almost always in the
+// same one or two cache lines. That suits anything that walks neighbourhoods: Dijkstra, blurs, propagation.
+UENUM(BlueprintType)
+enum EGAGridMapLayout : uint8
+{
+	GAML_Linear		UMETA(DisplayName = "Linear"),
+	GAML_Tiled		UMETA(DisplayName = "Tiled 8x8"),
+};
+
+
+// How the values of an FGAGridMap are stored
+// Float is the working format -- the kernels and the searches all want it. The two 16-bit formats halve the memory of
+// a map that's mostly being kept around and read (debug copies, cached scores), at the price of precision:
+//    Half   : IEEE fp16, about 3 significant digits over a huge range (big values like FLT_MAX become infinity)
+//    UInt16 : 65536 evenly spaced steps between the min and max value the map had when it was packed
+UENUM(BlueprintType)
+enum EGAGridMapStorage : uint8
+{
+	GAMS_Float		UMETA(DisplayName = "Float"),
+	GAMS_Half		UMETA(DisplayName = "Half"),
+	GAMS_UInt16		UMETA(DisplayName = "UInt16 (scale and bias)"),
+};
+
+
+// One cell of a sparse layer over an FGAGridMap: the cell's index into the map's Data (see LocalToIndex), and a value
+// Handy when only a small part of a map matters, e.g. the cells Dijkstra actually reached.
+struct FGASparseCell
+{
+	int32 Index;
+	float Value;
+};
+
+
+// How Combine folds a layer of values into a map
+enum class EGAMapOp : uint8
+{
+	Assign,			// Value = Layer
+	Add,			// Value = Value + Layer
+	Multiply,		// Value = Value * Layer
+};
+
+
 USTRUCT(BlueprintType)
 struct FGAGridMap
 {
@@ -59,10 +103,17 @@ struct FGAGridMap
 	FGAGridMap();
 	FGAGridMap(int32 XCountIn, int32 YCountIn, float InitialValue);
 	FGAGridMap(const AGAGridActor *Grid, float InitialValue);
-	FGAGridMap(const AGAGridActor* Grid, const FGridBox &GridBoxIn, float InitialValue);
+	FGAGridMap(const AGAGridActor* Grid, const FGridBox &GridBoxIn, float InitialValue, EGAGridMapLayout LayoutIn = GAML_Linear);
 
+	// Note: this always leaves the map in float storage
 	void ResetData(float InitialValue);
 
+	// Switch to a different layout, keeping the values
+	void SetLayout(EGAGridMapLayout NewLayout);
+
+	// Switch to a different storage format, keeping the values (as best the new format can)
+	void SetStorage(EGAGridMapStorage NewStorage);
+
 	// The XCount of the GridActor I'm built on
 	UPROPERTY(BlueprintReadOnly)
 	int32 XCount;
@@ -78,9 +129,28 @@ struct FGAGridMap
 	UPROPERTY(BlueprintReadOnly)
 	FGridBox GridBounds;
 
+	UPROPERTY(BlueprintReadOnly)
+	TEnumAsByte<EGAGridMapLayout> Layout;
+
+	// The values, in the order given by Layout -- use LocalToIndex to find a cell. Note that when tiled, the map is
+	// padded out to a whole number of tiles, and the padding cells are not part of the map.
 	UPROPERTY(BlueprintReadOnly)
 	TArray<float> Data;
 
+	UPROPERTY(BlueprintReadOnly)
+	TEnumAsByte<EGAGridMapStorage> Storage = GAMS_Float;
+
+	// When Storage isn't Float, the values live here instead of in Data (same order, same count)
+	UPROPERTY()
+	TArray<uint16> PackedData;
+
+	// For UInt16 storage: Value = Code * PackScale + PackBias
+	UPROPERTY()
+	float PackScale = 1.0f;
+
+	UPROPERTY()
+	float PackBias = 0.0f;
+
 
 	bool CellRefToLocal(const FCellRef& Cell, int32& X, int32& Y) const;
 
@@ -90,11 +160,284 @@ struct FGAGridMap
 
 	bool GetMaxValue(float& MaxValueOut) const;
 
+	bool GetMinValue(float& MinValueOut) const;
+
+	bool GetMinMaxValue(float& MinValueOut, float& MaxValueOut) const;
+
+	// The cell with the highest value (the first one, if there's a tie)
+	bool GetArgMax(FCellRef& CellOut, float& MaxValueOut) const;
+
 	bool SetValue(const FCellRef& Cell, float Value);
 
 
 	FORCEINLINE bool IsValid() const
 	{
-		return GridBounds.IsValid() && (GridBounds.GetCellCount() == Data.Num());
+		return GridBounds.IsValid() && (GetStorageCount() == ((Storage == GAMS_Float) ? Data.Num() : PackedData.Num()));
+	}
+
+	// Valid, and in float storage -- i.e. Data can be used directly. Everything that works on Data needs this.
+	FORCEINLINE bool IsFloatValid() const
+	{
+		return (Storage == GAMS_Float) && IsValid();
+	}
+
+	SIZE_T GetAllocatedSize() const { return Data.GetAllocatedSize() + PackedData.GetAllocatedSize(); }
+
+	// Same bounds and layout, so our Data lines up with theirs index for index
+	bool IsCompatible(const FGAGridMap& Other) const
+	{
+		return IsFloatValid() && Other.IsFloatValid() && (Layout == Other.Layout) &&
+			(GridBounds.MinX == Other.GridBounds.MinX) && (GridBounds.MaxX == Other.GridBounds.MaxX) &&
+			(GridBounds.MinY == Other.GridBounds.MinY) && (GridBounds.MaxY == Other.GridBounds.MaxY);
+	}
+
+	// Whole-map kernels --------------------------------
+	// These all work directly on Data, four floats at a time using the engine's vector intrinsics (so SSE or NEON),
+	// so they run at about memory speed. The ones taking another map need it to be IsCompatible with this one.
+	// The ones that modify the map do nothing unless it's in float storage. The reductions work in any storage.
+
+	void Fill(float Value);
+
+	// Value = Value + Other
+	bool Add(const FGAGridMap& Other);
+
+	// Value = Value * Other
+	bool Multiply(const FGAGridMap& Other);
+
+	// Value = Value * Scale + Bias
+	void ScaleBias(float Scale, float Bias);
+
+	void Clamp(float MinValue, float MaxValue);
+
+	// Remap the values so they span [0, 1]. If they're all the same, they all become 0.
+	bool Normalize();
+
+	// Map algebra: fold a whole layer of values into this map in one pass
+	// The layer is either another compatible map, or a raw buffer of Data.Num() values in our storage order
+	// (so the easiest way to build one is to copy a map with the same bounds and layout, and fill it with ForEachCell).
+	bool Combine(const FGAGridMap& Layer, EGAMapOp Op);
+	bool Combine(TArrayView<const float> LayerValues, EGAMapOp Op);
+
+	// Same, but only for the given cells -- everything else is left alone
+	bool CombineSparse(TArrayView<const FGASparseCell> LayerCells, EGAMapOp Op);
+
+	// The cell with the highest value out of the given ones (their Value is ignored, we look at ours)
+	bool GetArgMaxSparse(TArrayView<const FGASparseCell> Cells, FCellRef& CellOut, float& MaxValueOut) const;
+
+	// Set every cell whose value in Mask is >= Threshold to MaskedValue
+	// e.g. MaskWhereAtLeast(DistanceMap, FLT_MAX, -FLT_MAX) knocks out every cell Dijkstra didn't reach.
+	bool MaskWhereAtLeast(const FGAGridMap& Mask, float Threshold, float MaskedValue);
+
+	// Layout --------------------------------
+
+	static constexpr int32 TileSize = 8;
+	static constexpr int32 TileShift = 3;
+	static constexpr int32 TileMask = TileSize - 1;
+	static constexpr int32 TileCellCount = TileSize * TileSize;
+
+	// Index into Data of the given local cell (relative to GridBounds.MinX/MinY). No bounds checking.
+	FORCEINLINE int32 LocalToIndex(int32 X, int32 Y) const
+	{
+		if (Layout == GAML_Tiled)
+		{
+			return (((Y >> TileShift) * GetTileCountX() + (X >> TileShift)) << (2 * TileShift)) + ((Y & TileMask) << TileShift) + (X & TileMask);
+		}
+		return Y * GridBounds.GetWidth() + X;
+	}
+
+	// Inverse of LocalToIndex
+	void IndexToLocal(int32 Index, int32& X, int32& Y) const;
+
+	// The value at the given index into Data (or PackedData), whatever the storage
+	FORCEINLINE float GetValueAtIndex(int32 Index) const
+	{
+		switch (Storage)
+		{
+		case GAMS_Half:
+			return FPlatformMath::LoadHalf(&PackedData[Index]);
+		case GAMS_UInt16:
+			return float(PackedData[Index]) * PackScale + PackBias;
+		default:
+			return Data[Index];
+		}
+	}
+
+	// Copy Count values from StartIndex on out as floats, whatever the storage. The packed formats unpack four at a time.
+	void UnpackValues(int32 StartIndex, int32 Count, float* ValuesOut) const;
+
+	// Number of tiles across and down. The tile grid is anchored at the map's own MinX/MinY corner.
+	FORCEINLINE int32 GetTileCountX() const { return (GridBounds.GetWidth() + TileMask) >> TileShift; }
+	FORCEINLINE int32 GetTileCountY() const { return (GridBounds.GetHeight() + TileMask) >> TileShift; }
+
+	// How many floats Data needs for our bounds and layout
+	int32 GetStorageCount() const
+	{
+		if (!GridBounds.IsValid())
+		{
+			return 0;
+		}
+		return (Layout == GAML_Tiled) ? GetTileCountX() * GetTileCountY() * TileCellCount : GridBounds.GetCellCount();
+	}
+
+	// Iterators --------------------------------
+
+	// Unchecked view of local row Y of a linear map. Good for tight loops that want to skip GetValue/SetValue's checks.
+	FORCEINLINE TArrayView<float> GetRowView(int32 Y)
+	{
+		checkSlow((Layout == GAML_Linear) && (Y >= 0) && (Y < GridBounds.GetHeight()));
+		return TArrayView<float>(Data.GetData() + Y * GridBounds.GetWidth(), GridBounds.GetWidth());
+	}
+
+	FORCEINLINE TArrayView<const float> GetRowView(int32 Y) const
+	{
+		checkSlow((Layout == GAML_Linear) && (Y >= 0) && (Y < GridBounds.GetHeight()));
+		return TArrayView<const float>(Data.GetData() + Y * GridBounds.GetWidth(), GridBounds.GetWidth());
+	}
+
+	// Call Func(LocalX, LocalY, Value) for every cell, visiting them in memory order (so tile by tile, when tiled)
+	// Float storage only.
+	template<typename FuncType>
+	void ForEachCell(FuncType&& Func)
+	{
+		ForEachCellImpl(*this, Data.GetData(), Func);
+	}
+
+	template<typename FuncType>
+	void ForEachCell(FuncType&& Func) const
+	{
+		ForEachCellImpl(*this, Data.GetData(), Func);
+	}
+
+	// Call Func(TileBounds, TileValues) for every 8x8 tile of a tiled map. TileBounds is in local cells, clipped to
+	// the map, and TileValues points to the 64 values of the tile, in rows of TileSize (so the value of local
+	// cell (X, Y) is TileValues[(Y - TileBounds.MinY) * TileSize + (X - TileBounds.MinX)]).
+	template<typename FuncType>
+	void ForEachTile(FuncType&& Func)
+	{
+		check((Layout == GAML_Tiled) && (Storage == GAMS_Float));
+		const int32 Width = GridBounds.GetWidth();
+		const int32 Height = GridBounds.GetHeight();
+		float* TileValues = Data.GetData();
+
+		for (int32 TileY = 0; TileY < GetTileCountY(); TileY++)
+		{
+			for (int32 TileX = 0; TileX < GetTileCountX(); TileX++)
+			{
+				const int32 MinX = TileX << TileShift;
+				const int32 MinY = TileY << TileShift;
+				Func(FGridBox(MinX, FMath::Min(MinX + TileMask, Width - 1), MinY, FMath::Min(MinY + TileMask, Height - 1)), TileValues);
+				TileValues += TileCellCount;
+			}
+		}
+	}
+
+private:
+	// Call Func(StartIndex, Count) for each contiguous run of Data that holds map cells (i.e. skipping any padding)
+	// That's the whole array for a linear map, or a tile (or a row of an edge tile) at a time for a tiled one.
+	template<typename FuncType>
+	void ForEachSpan(FuncType&& Func) const
+	{
+		if (Layout != GAML_Tiled)
+		{
+			Func(0, GetStorageCount());
+			return;
+		}
+
+		const int32 Width = GridBounds.GetWidth();
+		const int32 Height = GridBounds.GetHeight();
+		int32 TileStart = 0;
+
+		for (int32 TileY = 0; TileY < GetTileCountY(); TileY++)
+		{
+			for (int32 TileX = 0; TileX < GetTileCountX(); TileX++)
+			{
+				const int32 TileWidth = FMath::Min(Width - (TileX << TileShift), TileSize);
+				const int32 TileHeight = FMath::Min(Height - (TileY << TileShift), TileSize);
+
+				if (TileWidth == TileSize)
+				{
+					Func(TileStart, TileHeight * TileSize);
+				}
+				else
+				{
+					for (int32 Row = 0; Row < TileHeight; Row++)
+					{
+						Func(TileStart + Row * TileSize, TileWidth);
+					}
+				}
+				TileStart += TileCellCount;
+			}
+		}
+	}
+
+	// Like ForEachSpan, but calls Func(StartIndex, Values, Count) with the span's values as floats. Packed storage is
+	// unpacked a chunk at a time onto the stack, so reductions don't need an unpacked copy of the whole map.
+	template<typename FuncType>
+	void ForEachValueSpan(FuncType&& Func) const
+	{
+		if (Storage == GAMS_Float)
+		{
+			ForEachSpan([&](int32 StartIndex, int32 Count) { Func(StartIndex, Data.GetData() + StartIndex, Count); });
+			return;
+		}
+
+		ForEachSpan([&](int32 StartIndex, int32 Count)
+		{
+			float Chunk[UnpackChunkSize];
+			for (int32 Offset = 0; Offset < Count; Offset += UnpackChunkSize)
+			{
+				const int32 ChunkCount = FMath::Min(Count - Offset, UnpackChunkSize);
+				UnpackValues(StartIndex + Offset, ChunkCount, Chunk);
+				Func(StartIndex + Offset, Chunk, ChunkCount);
+			}
+		});
+	}
+
+	static constexpr int32 UnpackChunkSize = 256;
+
+	template<typename ValueType, typename FuncType>
+	static void ForEachCellImpl(const FGAGridMap& Map, ValueType* Values, FuncType& Func)
+	{
+		if (!Map.IsFloatValid())
+		{
+			return;
+		}
+
+		const int32 Width = Map.GridBounds.GetWidth();
+		const int32 Height = Map.GridBounds.GetHeight();
+
+		if (Map.Layout == GAML_Tiled)
+		{
+			for (int32 TileY = 0; TileY < Map.GetTileCountY(); TileY++)
+			{
+				for (int32 TileX = 0; TileX < Map.GetTileCountX(); TileX++)
+				{
+					const int32 MinX = TileX << TileShift;
+					const int32 MinY = TileY << TileShift;
+					const int32 MaxX = FMath::Min(MinX + TileMask, Width - 1);
+					const int32 MaxY = FMath::Min(MinY + TileMask, Height - 1);
+
+					for (int32 Y = MinY; Y <= MaxY; Y++)
+					{
+						ValueType* Row = Values + ((Y & TileMask) << TileShift);
+						for (int32 X = MinX; X <= MaxX; X++)
+						{
+							Func(X, Y, Row[X & TileMask]);
+						}
+					}
+					Values += TileCellCount;
+				}
+			}
+		}
+		else
+		{
+			for (int32 Y = 0; Y < Height; Y++)
+			{
+				for (int32 X = 0; X < Width; X++)
+				{
+					Func(X, Y, *Values++);
+				}
+			}
+		}
 	}
 };
\ No newline at end of file
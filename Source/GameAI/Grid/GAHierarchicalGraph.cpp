@@ -0,0 +1,316 @@
+#include "GAHierarchicalGraph.h"
+#include "GAGridActor.h"
+#include "GAJumpPointTable.h"
+
+
+namespace
+{
+	struct FClusterNode
+	{
+		int32 LocalIndex;
+		float Cost;
+	};
+
+	struct FClusterNodePredicate
+	{
+		FORCEINLINE bool operator()(const FClusterNode& A, const FClusterNode& B) const
+		{
+			return A.Cost < B.Cost;
+		}
+	};
+}
+
+
+void FGAHierarchicalGraph::Empty()
+{
+	ClustersX = 0;
+	ClustersY = 0;
+	XCount = 0;
+	YCount = 0;
+	Clusters.Empty();
+}
+
+
+void FGAHierarchicalGraph::Build(const AGAGridActor* Grid, int32 ClusterSizeIn)
+{
+	ClusterSize = FMath::Max(ClusterSizeIn, 2);
+	XCount = Grid->XCount;
+	YCount = Grid->YCount;
+	ClustersX = FMath::DivideAndRoundUp(XCount, ClusterSize);
+	ClustersY = FMath::DivideAndRoundUp(YCount, ClusterSize);
+
+	Clusters.Reset();
+	Clusters.SetNum(ClustersX * ClustersY);
+
+	for (int32 ClusterIndex = 0; ClusterIndex < Clusters.Num(); ClusterIndex++)
+	{
+		BuildCluster(Grid, ClusterIndex);
+	}
+}
+
+
+void FGAHierarchicalGraph::RebuildRegion(const AGAGridActor* Grid, const FGridBox& ChangedCells)
+{
+	if (!IsValidFor(Grid->XCount, Grid->YCount))
+	{
+		Build(Grid, ClusterSize);
+		return;
+	}
+
+	// A cluster depends on its own cells, plus the ring of cells just outside it (for the entrances).
+	// So grow the box by one cell and rebuild every cluster it touches.
+	const int32 MinCX = FMath::Max(ChangedCells.MinX - 1, 0) / ClusterSize;
+	const int32 MaxCX = FMath::Min(ChangedCells.MaxX + 1, XCount - 1) / ClusterSize;
+	const int32 MinCY = FMath::Max(ChangedCells.MinY - 1, 0) / ClusterSize;
+	const int32 MaxCY = FMath::Min(ChangedCells.MaxY + 1, YCount - 1) / ClusterSize;
+
+	for (int32 CY = MinCY; CY <= MaxCY; CY++)
+	{
+		for (int32 CX = MinCX; CX <= MaxCX; CX++)
+		{
+			BuildCluster(Grid, CY * ClustersX + CX);
+		}
+	}
+}
+
+
+FGridBox FGAHierarchicalGraph::GetClusterBounds(int32 ClusterIndex) const
+{
+	const int32 CX = ClusterIndex % ClustersX;
+	const int32 CY = ClusterIndex / ClustersX;
+
+	return FGridBox(
+		CX * ClusterSize, FMath::Min((CX + 1) * ClusterSize, XCount) - 1,
+		CY * ClusterSize, FMath::Min((CY + 1) * ClusterSize, YCount) - 1);
+}
+
+
+int32 FGAHierarchicalGraph::FindNode(int32 ClusterIndex, int32 CellIndex) const
+{
+	// Clusters only have a handful of nodes, so a linear search is fine
+	return Clusters[ClusterIndex].NodeCells.Find(CellIndex);
+}
+
+
+int32 FGAHierarchicalGraph::GetNodeCount() const
+{
+	int32 Result = 0;
+	for (const FGAHierarchyCluster& Cluster : Clusters)
+	{
+		Result += Cluster.NodeCells.Num();
+	}
+	return Result;
+}
+
+
+SIZE_T FGAHierarchicalGraph::GetAllocatedSize() const
+{
+	SIZE_T Result = Clusters.GetAllocatedSize();
+	for (const FGAHierarchyCluster& Cluster : Clusters)
+	{
+		Result += Cluster.NodeCells.GetAllocatedSize() + Cluster.IntraCosts.GetAllocatedSize() + Cluster.InterEdges.GetAllocatedSize();
+	}
+	return Result;
+}
+
+
+void FGAHierarchicalGraph::GetBorderTransitions(const AGAGridActor* Grid, int32 ClusterIndex, int32 NeighborIndex, TArray<FIntPoint>& TransitionsOut) const
+{
+	const FGridBox Bounds = GetClusterBounds(ClusterIndex);
+	const int32 DX = (NeighborIndex % ClustersX) - (ClusterIndex % ClustersX);
+	const int32 DY = (NeighborIndex / ClustersX) - (ClusterIndex / ClustersX);
+	check(FMath::Abs(DX) + FMath::Abs(DY) == 1);
+
+	// Walk along the shared border. T is the coordinate along the border, and for each T our cell is (X, Y)
+	// and theirs is (X + DX, Y + DY). Both clusters walk the border in the same order, so they agree on the entrances.
+	const bool bVerticalBorder = (DX != 0);
+	const int32 TMin = bVerticalBorder ? Bounds.MinY : Bounds.MinX;
+	const int32 TMax = bVerticalBorder ? Bounds.MaxY : Bounds.MaxX;
+	const int32 Fixed = bVerticalBorder ? ((DX > 0) ? Bounds.MaxX : Bounds.MinX) : ((DY > 0) ? Bounds.MaxY : Bounds.MinY);
+
+	auto AddTransition = [&](int32 T)
+	{
+		const int32 X = bVerticalBorder ? Fixed : T;
+		const int32 Y = bVerticalBorder ? T : Fixed;
+		TransitionsOut.Add(FIntPoint(Y * XCount + X, (Y + DY) * XCount + (X + DX)));
+	};
+
+	int32 RunStart = INDEX_NONE;
+	for (int32 T = TMin; T <= TMax + 1; T++)
+	{
+		bool bOpen = false;
+		if (T <= TMax)
+		{
+			const int32 X = bVerticalBorder ? Fixed : T;
+			const int32 Y = bVerticalBorder ? T : Fixed;
+			bOpen = Grid->IsTraversable(X, Y) && Grid->IsTraversable(X + DX, Y + DY);
+		}
+
+		if (bOpen && (RunStart == INDEX_NONE))
+		{
+			RunStart = T;
+		}
+		else if (!bOpen && (RunStart != INDEX_NONE))
+		{
+			const int32 RunEnd = T - 1;
+			if (RunEnd - RunStart + 1 >= WideEntranceWidth)
+			{
+				AddTransition(RunStart);
+				AddTransition(RunEnd);
+			}
+			else
+			{
+				AddTransition((RunStart + RunEnd) / 2);
+			}
+			RunStart = INDEX_NONE;
+		}
+	}
+}
+
+
+void FGAHierarchicalGraph::ClusterDijkstra(const AGAGridActor* Grid, const FGridBox& Bounds, int32 StartX, int32 StartY, TArray<float>& CostsOut) const
+{
+	const int32 Width = Bounds.GetWidth();
+	const int32 CellCount = Bounds.GetCellCount();
+
+	CostsOut.Init(FLT_MAX, CellCount);
+
+	if (!Grid->IsTraversable(StartX, StartY))
+	{
+		return;
+	}
+
+	TArray<bool> Closed;
+	Closed.Init(false, CellCount);
+
+	TArray<FClusterNode> Open;
+	const FClusterNodePredicate Predicate;
+
+	const int32 StartLocal = (StartY - Bounds.MinY) * Width + (StartX - Bounds.MinX);
+	CostsOut[StartLocal] = 0.0f;
+	Open.HeapPush(FClusterNode{ StartLocal, 0.0f }, Predicate);
+
+	while (Open.Num() > 0)
+	{
+		FClusterNode Node;
+		Open.HeapPop(Node, Predicate, false);
+
+		if (Closed[Node.LocalIndex])
+		{
+			continue;
+		}
+		Closed[Node.LocalIndex] = true;
+
+		const int32 X = Bounds.MinX + Node.LocalIndex % Width;
+		const int32 Y = Bounds.MinY + Node.LocalIndex / Width;
+
+		for (int32 Direction = 0; Direction < 8; Direction++)
+		{
+			const int32 DX = FGAJumpPointTable::DirectionDX[Direction];
+			const int32 DY = FGAJumpPointTable::DirectionDY[Direction];
+			const int32 NX = X + DX;
+			const int32 NY = Y + DY;
+
+			if (!Bounds.IsValidCell(FCellRef(NX, NY)) || !Grid->IsTraversable(NX, NY))
+			{
+				continue;
+			}
+
+			float StepCost = 1.0f;
+			if (FGAJumpPointTable::IsDiagonal(Direction))
+			{
+				if (!Grid->IsTraversable(NX, Y) || !Grid->IsTraversable(X, NY))
+				{
+					continue;
+				}
+				StepCost = UE_SQRT_2;
+			}
+
+			const int32 NeighborLocal = (NY - Bounds.MinY) * Width + (NX - Bounds.MinX);
+			const float NewCost = Node.Cost + StepCost;
+			if (!Closed[NeighborLocal] && (NewCost < CostsOut[NeighborLocal]))
+			{
+				CostsOut[NeighborLocal] = NewCost;
+				Open.HeapPush(FClusterNode{ NeighborLocal, NewCost }, Predicate);
+			}
+		}
+	}
+}
+
+
+void FGAHierarchicalGraph::BuildCluster(const AGAGridActor* Grid, int32 ClusterIndex)
+{
+	FGAHierarchyCluster& Cluster = Clusters[ClusterIndex];
+	Cluster.NodeCells.Reset();
+	Cluster.IntraCosts.Reset();
+	Cluster.InterEdges.Reset();
+
+	const int32 CX = ClusterIndex % ClustersX;
+	const int32 CY = ClusterIndex / ClustersX;
+
+	// Find the entrances on each of our four borders
+	TArray<FIntPoint> Transitions;
+	if (CX > 0)
+	{
+		GetBorderTransitions(Grid, ClusterIndex, ClusterIndex - 1, Transitions);
+	}
+	if (CX < ClustersX - 1)
+	{
+		GetBorderTransitions(Grid, ClusterIndex, ClusterIndex + 1, Transitions);
+	}
+	if (CY > 0)
+	{
+		GetBorderTransitions(Grid, ClusterIndex, ClusterIndex - ClustersX, Transitions);
+	}
+	if (CY < ClustersY - 1)
+	{
+		GetBorderTransitions(Grid, ClusterIndex, ClusterIndex + ClustersX, Transitions);
+	}
+
+	for (const FIntPoint& Transition : Transitions)
+	{
+		// Note, a corner cell can be an entrance on two borders, but it's still just one node
+		const int32 LocalNode = Cluster.NodeCells.AddUnique(Transition.X);
+		Cluster.InterEdges.Add(FIntPoint(LocalNode, Transition.Y));
+	}
+
+	// Cache the costs between every pair of nodes
+	const int32 NodeCount = Cluster.NodeCells.Num();
+	Cluster.IntraCosts.Init(FLT_MAX, NodeCount * NodeCount);
+
+	const FGridBox Bounds = GetClusterBounds(ClusterIndex);
+	const int32 Width = Bounds.GetWidth();
+	TArray<float> Costs;
+
+	for (int32 From = 0; From < NodeCount; From++)
+	{
+		const int32 FromCell = Cluster.NodeCells[From];
+		ClusterDijkstra(Grid, Bounds, FromCell % XCount, FromCell / XCount, Costs);
+
+		for (int32 To = 0; To < NodeCount; To++)
+		{
+			const int32 ToCell = Cluster.NodeCells[To];
+			const int32 ToLocal = ((ToCell / XCount) - Bounds.MinY) * Width + ((ToCell % XCount) - Bounds.MinX);
+			Cluster.IntraCosts[From * NodeCount + To] = Costs[ToLocal];
+		}
+	}
+}
+
+
+void FGAHierarchicalGraph::GetCostsToNodes(const AGAGridActor* Grid, int32 X, int32 Y, TArray<float>& CostsOut) const
+{
+	const int32 ClusterIndex = GetClusterIndex(X, Y);
+	const FGAHierarchyCluster& Cluster = Clusters[ClusterIndex];
+	const FGridBox Bounds = GetClusterBounds(ClusterIndex);
+	const int32 Width = Bounds.GetWidth();
+
+	TArray<float> Costs;
+	ClusterDijkstra(Grid, Bounds, X, Y, Costs);
+
+	CostsOut.SetNum(Cluster.NodeCells.Num());
+	for (int32 Node = 0; Node < Cluster.NodeCells.Num(); Node++)
+	{
+		const int32 NodeCell = Cluster.NodeCells[Node];
+		CostsOut[Node] = Costs[((NodeCell / XCount) - Bounds.MinY) * Width + ((NodeCell % XCount) - Bounds.MinX)];
+	}
+}
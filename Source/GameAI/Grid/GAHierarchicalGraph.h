@@ -0,0 +1,90 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GAGridMap.h"
+
+class AGAGridActor;
+
+
+// One cluster of the abstract graph
+// Every abstract node is identified by the grid cell index (AGAGridActor::CellRefToIndex) of the cell it sits on.
+
+struct FGAHierarchyCluster
+{
+	// The cells of the abstract nodes in this cluster, i.e. our side of each entrance
+	TArray<int32> NodeCells;
+
+	// NodeCells.Num() x NodeCells.Num() matrix of path costs between our nodes, staying inside the cluster
+	// FLT_MAX if there is no such path
+	TArray<float> IntraCosts;
+
+	// Edges to the neighbouring clusters: X is the index of our node (into NodeCells), Y is the grid cell index
+	// of the node on the other side. Always a single straight step.
+	TArray<FIntPoint> InterEdges;
+};
+
+
+// An HPA* style abstraction of an AGAGridActor (Botea, Mueller & Schaeffer, "Near Optimal Hierarchical Path-Finding")
+// The grid is split into square clusters of ClusterSize cells. Wherever two neighbouring clusters share a run of
+// open cells along their border, we place one entrance (or two, for wide runs), which gives an abstract node on
+// each side. The costs between the nodes of a cluster are cached, so a long query only has to search the small
+// abstract graph, and then refine the abstract path one cluster at a time.
+//
+// Everything about a cluster is a function of the cells in and right next to it, so when some cells change
+// only the clusters around them need rebuilding (see RebuildRegion).
+
+class FGAHierarchicalGraph
+{
+public:
+	// Runs of open border cells at least this wide get an entrance at each end rather than one in the middle
+	static constexpr int32 WideEntranceWidth = 6;
+
+	void Build(const AGAGridActor* Grid, int32 ClusterSizeIn);
+
+	// Rebuild just the clusters affected by a change to the given cells
+	void RebuildRegion(const AGAGridActor* Grid, const FGridBox& ChangedCells);
+
+	void Empty();
+
+	bool IsValidFor(int32 XCountIn, int32 YCountIn) const
+	{
+		return (XCount == XCountIn) && (YCount == YCountIn) && (Clusters.Num() > 0);
+	}
+
+	FORCEINLINE int32 GetClusterIndex(int32 X, int32 Y) const
+	{
+		return (Y / ClusterSize) * ClustersX + (X / ClusterSize);
+	}
+
+	FGridBox GetClusterBounds(int32 ClusterIndex) const;
+
+	const FGAHierarchyCluster& GetCluster(int32 ClusterIndex) const { return Clusters[ClusterIndex]; }
+
+	// Index into the cluster's NodeCells of the node on the given cell, or INDEX_NONE
+	int32 FindNode(int32 ClusterIndex, int32 CellIndex) const;
+
+	// Path costs from the given cell to each of the nodes of its cluster, without leaving the cluster
+	// Used to hook the start and goal of a query into the abstract graph.
+	void GetCostsToNodes(const AGAGridActor* Grid, int32 X, int32 Y, TArray<float>& CostsOut) const;
+
+	int32 GetNodeCount() const;
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	void BuildCluster(const AGAGridActor* Grid, int32 ClusterIndex);
+
+	// The entrances between two clusters that share a border, as pairs of grid cell indices (our side, their side)
+	void GetBorderTransitions(const AGAGridActor* Grid, int32 ClusterIndex, int32 NeighborIndex, TArray<FIntPoint>& TransitionsOut) const;
+
+	// Dijkstra over a single cluster. CostsOut is indexed by cluster-local cell, (Y - MinY) * Width + (X - MinX).
+	void ClusterDijkstra(const AGAGridActor* Grid, const FGridBox& Bounds, int32 StartX, int32 StartY, TArray<float>& CostsOut) const;
+
+	int32 ClusterSize = 16;
+	int32 ClustersX = 0;
+	int32 ClustersY = 0;
+	int32 XCount = 0;
+	int32 YCount = 0;
+
+	TArray<FGAHierarchyCluster> Clusters;
+};
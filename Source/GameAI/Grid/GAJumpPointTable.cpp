@@ -0,0 +1,110 @@
+#include "GAJumpPointTable.h"
+#include "GAGridActor.h"
+
+
+void FGAJumpPointTable::Empty()
+{
+	XCount = 0;
+	YCount = 0;
+	Distances.Empty();
+}
+
+
+bool FGAJumpPointTable::IsPrimaryJumpPoint(const AGAGridActor* Grid, int32 X, int32 Y, int32 Direction) const
+{
+	const int32 DX = DirectionDX[Direction];
+	const int32 DY = DirectionDY[Direction];
+
+	if (DY == 0)
+	{
+		// Travelling horizontally: is there an opening above or below us that was walled off for the previous cell?
+		return (Grid->IsTraversable(X, Y + 1) && !Grid->IsTraversable(X - DX, Y + 1)) ||
+			(Grid->IsTraversable(X, Y - 1) && !Grid->IsTraversable(X - DX, Y - 1));
+	}
+	else
+	{
+		return (Grid->IsTraversable(X + 1, Y) && !Grid->IsTraversable(X + 1, Y - DY)) ||
+			(Grid->IsTraversable(X - 1, Y) && !Grid->IsTraversable(X - 1, Y - DY));
+	}
+}
+
+
+void FGAJumpPointTable::Build(const AGAGridActor* Grid)
+{
+	XCount = Grid->XCount;
+	YCount = Grid->YCount;
+
+	// Distances are stored as int16, so the grid can't be any longer than that on a side
+	if (!ensure((XCount < MAX_int16) && (YCount < MAX_int16)))
+	{
+		Empty();
+		return;
+	}
+
+	Distances.SetNumZeroed(XCount * YCount * 8);
+
+	// Each direction is a single sweep against the direction of travel, so that the next cell along has always
+	// been done by the time we get to a cell. The straight directions have to go first, since the diagonals use them.
+
+	for (int32 Direction = 0; Direction < 8; Direction++)
+	{
+		const int32 DX = DirectionDX[Direction];
+		const int32 DY = DirectionDY[Direction];
+
+		const int32 XStart = (DX > 0) ? XCount - 1 : 0;
+		const int32 XStep = (DX > 0) ? -1 : 1;
+		const int32 YStart = (DY > 0) ? YCount - 1 : 0;
+		const int32 YStep = (DY > 0) ? -1 : 1;
+
+		const int32 HorizontalDirection = GetStraightDirection(DX, 0);
+		const int32 VerticalDirection = GetStraightDirection(0, DY);
+
+		for (int32 YIter = 0, Y = YStart; YIter < YCount; YIter++, Y += YStep)
+		{
+			for (int32 XIter = 0, X = XStart; XIter < XCount; XIter++, X += XStep)
+			{
+				if (!Grid->IsTraversable(X, Y))
+				{
+					continue;
+				}
+
+				const int32 NX = X + DX;
+				const int32 NY = Y + DY;
+				int32 Value = 0;
+
+				if (!IsDiagonal(Direction))
+				{
+					if (Grid->IsTraversable(NX, NY))
+					{
+						if (IsPrimaryJumpPoint(Grid, NX, NY, Direction))
+						{
+							Value = 1;
+						}
+						else
+						{
+							int32 Next = GetDistance(NY * XCount + NX, Direction);
+							Value = (Next > 0) ? Next + 1 : Next - 1;
+						}
+					}
+				}
+				else if (Grid->IsTraversable(NX, NY) && Grid->IsTraversable(NX, Y) && Grid->IsTraversable(X, NY))
+				{
+					const int32 NextIndex = NY * XCount + NX;
+
+					// The next cell is a jump point if a straight jump out of it (in either of our component directions) finds one
+					if ((GetDistance(NextIndex, HorizontalDirection) > 0) || (GetDistance(NextIndex, VerticalDirection) > 0))
+					{
+						Value = 1;
+					}
+					else
+					{
+						int32 Next = GetDistance(NextIndex, Direction);
+						Value = (Next > 0) ? Next + 1 : Next - 1;
+					}
+				}
+
+				Distances[(Y * XCount + X) * 8 + Direction] = int16(Value);
+			}
+		}
+	}
+}
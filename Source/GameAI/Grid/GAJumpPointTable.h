@@ -0,0 +1,55 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AGAGridActor;
+
+
+// Precomputed jump distances for JPS+ (Jump Point Search with preprocessing, see Rabin's chapter in Game AI Pro 2)
+// For every cell and each of the 8 directions we store how far you can travel in that direction:
+//    > 0  : the distance to the next jump point in that direction
+//    <= 0 : there is no jump point that way, and -value is the number of steps before hitting a wall
+// The table follows the same movement rules as FGAGridSearch -- 8-connected, no corner cutting.
+// It is derived data: AGAGridActor rebuilds it whenever the traversability data changes.
+
+struct FGAJumpPointTable
+{
+	// Direction order is shared with the grid searches: the four straight directions, then the four diagonals
+	static constexpr int32 DirectionDX[8] = { 1, -1, 0, 0, 1, -1, 1, -1 };
+	static constexpr int32 DirectionDY[8] = { 0, 0, 1, -1, 1, 1, -1, -1 };
+
+	static FORCEINLINE bool IsDiagonal(int32 Direction) { return Direction >= 4; }
+
+	// Look up the straight direction index for a given step
+	static int32 GetStraightDirection(int32 DX, int32 DY)
+	{
+		return (DX > 0) ? 0 : (DX < 0) ? 1 : (DY > 0) ? 2 : 3;
+	}
+
+	void Build(const AGAGridActor* Grid);
+
+	void Empty();
+
+	// Is the table in sync with a grid of the given size?
+	bool IsValidFor(int32 XCountIn, int32 YCountIn) const
+	{
+		return (XCount == XCountIn) && (YCount == YCountIn) && (Distances.Num() == XCount * YCount * 8);
+	}
+
+	FORCEINLINE int32 GetDistance(int32 CellIndex, int32 Direction) const
+	{
+		return Distances[CellIndex * 8 + Direction];
+	}
+
+	SIZE_T GetAllocatedSize() const { return Distances.GetAllocatedSize(); }
+
+private:
+	// Is the given cell a primary jump point when entered travelling in the given straight direction?
+	// i.e. does it have a forced neighbour, which is the case if a wall beside us just ended
+	bool IsPrimaryJumpPoint(const AGAGridActor* Grid, int32 X, int32 Y, int32 Direction) const;
+
+	int32 XCount = 0;
+	int32 YCount = 0;
+
+	TArray<int16> Distances;
+};
@@ -0,0 +1,192 @@
+#include "GAVisibilityField.h"
+#include "GameAI/GameAI.h"
+
+DECLARE_CYCLE_STAT(TEXT("GA Build Visibility Field"), STAT_GABuildVisibilityField, STATGROUP_GameAI);
+
+
+namespace
+{
+	// Slopes are kept as exact fractions (Col / Depth, in half cells), so lines through corners come out the same
+	// way every time rather than depending on rounding
+	struct FSlope
+	{
+		int64 Num;
+		int64 Den;		// always > 0
+	};
+
+	FORCEINLINE bool operator<(const FSlope& A, const FSlope& B) { return A.Num * B.Den < B.Num * A.Den; }
+	FORCEINLINE bool operator==(const FSlope& A, const FSlope& B) { return A.Num * B.Den == B.Num * A.Den; }
+
+	// A range of slopes that's still lit at the given depth. Either end can be open or closed.
+	struct FLitSpan
+	{
+		int32 Depth;
+		FSlope Lo;
+		FSlope Hi;
+		bool bLoClosed;
+		bool bHiClosed;
+
+		bool Contains(const FSlope& Slope) const
+		{
+			if ((Slope < Lo) || (Hi < Slope))
+			{
+				return false;
+			}
+			return (bLoClosed || !(Slope == Lo)) && (bHiClosed || !(Slope == Hi));
+		}
+	};
+
+	FORCEINLINE bool IsSpanEmpty(const FSlope& Lo, bool bLoClosed, const FSlope& Hi, bool bHiClosed)
+	{
+		return (Hi < Lo) || ((Lo == Hi) && !(bLoClosed && bHiClosed));
+	}
+
+	// Cell (X, Y) = Origin + Col * (XX, YX) + Depth * (XY, YY). Each octant covers 0 <= Col <= Depth.
+	const int32 Octants[8][4] =
+	{
+		{ 1, 0, 0, 1 }, { 0, 1, 1, 0 }, { -1, 0, 0, 1 }, { 0, -1, 1, 0 },
+		{ 1, 0, 0, -1 }, { 0, 1, -1, 0 }, { -1, 0, 0, -1 }, { 0, -1, -1, 0 },
+	};
+}
+
+
+bool FGAVisibilityField::Build(const FGAGridBitPlane& Traversable, const FCellRef& OriginIn, const FGridBox& BoxIn)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GABuildVisibilityField);
+
+	Origin = OriginIn;
+	Box = BoxIn;
+	if (!Box.IsValid() || (Box.MaxX < 0) || (Box.MaxY < 0) || (Box.MinX >= Traversable.GetXCount()) || (Box.MinY >= Traversable.GetYCount()))
+	{
+		Visible.Empty();
+		return false;
+	}
+
+	Visible.Init(Box.GetWidth(), Box.GetHeight());
+
+	const int32 OX = Origin.X;
+	const int32 OY = Origin.Y;
+	if (!Traversable.Get(OX, OY))
+	{
+		return true;
+	}
+
+	// A line between two cells never leaves the rectangle containing both, so the scan only needs to cover the box
+	// plus the origin
+	const int32 MinX = FMath::Max(FMath::Min(Box.MinX, OX), 0);
+	const int32 MaxX = FMath::Min(FMath::Max(Box.MaxX, OX), Traversable.GetXCount() - 1);
+	const int32 MinY = FMath::Max(FMath::Min(Box.MinY, OY), 0);
+	const int32 MaxY = FMath::Min(FMath::Max(Box.MaxY, OY), Traversable.GetYCount() - 1);
+
+	auto MarkVisible = [this](int32 X, int32 Y)
+	{
+		if ((X >= Box.MinX) && (X <= Box.MaxX) && (Y >= Box.MinY) && (Y <= Box.MaxY))
+		{
+			Visible.Set(X - Box.MinX, Y - Box.MinY, true);
+		}
+	};
+
+	MarkVisible(OX, OY);
+
+	auto GetExtent = [=](int32 DX, int32 DY)
+	{
+		return (DX > 0) ? (MaxX - OX) : (DX < 0) ? (OX - MinX) : (DY > 0) ? (MaxY - OY) : (OY - MinY);
+	};
+
+	TArray<FLitSpan, TInlineAllocator<64>> Spans;
+	for (const int32* Octant : Octants)
+	{
+		const int32 XX = Octant[0];
+		const int32 XY = Octant[1];
+		const int32 YX = Octant[2];
+		const int32 YY = Octant[3];
+
+		const int32 MaxDepth = GetExtent(XY, YY);
+		const int32 MaxCol = GetExtent(XX, YX);
+		if (MaxDepth < 1)
+		{
+			continue;
+		}
+
+		// The diagonal line passes exactly through cell corners, so it also needs the cells either side of it clear,
+		// including the one over in the next octant. Find the first depth where that stops being true.
+		const int32 DiagonalLength = FMath::Min(MaxDepth, MaxCol);
+		int32 DiagonalBlockedDepth = DiagonalLength + 1;
+		for (int32 K = 1; K <= DiagonalLength; K++)
+		{
+			if (!Traversable.Get(OX + (K - 1) * XX + K * XY, OY + (K - 1) * YX + K * YY) ||
+				!Traversable.Get(OX + K * XX + (K - 1) * XY, OY + K * YX + (K - 1) * YY))
+			{
+				DiagonalBlockedDepth = K;
+				break;
+			}
+		}
+
+		Spans.Reset();
+		Spans.Add({ 1, { 0, 1 }, { 1, 1 }, true, true });
+		while (Spans.Num() > 0)
+		{
+			const FLitSpan Span = Spans.Pop(false);
+			const int32 Depth = Span.Depth;
+
+			// A cell is visible if the line to its centre is in the span. A blocked cell shadows every line that touches
+			// it, i.e. slopes [(2C - 1) / (2D + 1), (2C + 1) / (2D - 1)], and those are cut out of the span for the next row.
+			// Blocked cells only shadow deeper rows: in the same row they could only touch the diagonal, handled above.
+			const double LoSlope = double(Span.Lo.Num) / double(Span.Lo.Den);
+			const double HiSlope = double(Span.Hi.Num) / double(Span.Hi.Den);
+			const int32 MinCol = FMath::Max(FMath::FloorToInt32((LoSlope * (2 * Depth - 1) - 1.0) * 0.5) - 1, 0);
+			const int32 MaxSpanCol = FMath::Min3(Depth, MaxCol, FMath::CeilToInt32((HiSlope * (2 * Depth + 1) + 1.0) * 0.5) + 1);
+
+			FSlope RemainingLo = Span.Lo;
+			bool bRemainingLoClosed = Span.bLoClosed;
+			bool bLit = true;
+
+			for (int32 Col = MinCol; Col <= MaxSpanCol; Col++)
+			{
+				const int32 X = OX + Col * XX + Depth * XY;
+				const int32 Y = OY + Col * YX + Depth * YY;
+
+				if (Traversable.Get(X, Y))
+				{
+					if (Span.Contains({ Col, Depth }) && ((Col < Depth) || (Depth < DiagonalBlockedDepth)))
+					{
+						MarkVisible(X, Y);
+					}
+					continue;
+				}
+
+				if (!bLit)
+				{
+					continue;
+				}
+
+				const FSlope ShadowLo = { 2 * Col - 1, 2 * Depth + 1 };
+				const FSlope ShadowHi = { 2 * Col + 1, 2 * Depth - 1 };
+				if ((ShadowHi < RemainingLo) || ((ShadowHi == RemainingLo) && !bRemainingLoClosed) ||
+					(Span.Hi < ShadowLo) || ((Span.Hi == ShadowLo) && !Span.bHiClosed))
+				{
+					continue;
+				}
+
+				// Whatever's lit before the shadow carries on to the next row
+				if ((Depth < MaxDepth) && !IsSpanEmpty(RemainingLo, bRemainingLoClosed, ShadowLo, false))
+				{
+					Spans.Add({ Depth + 1, RemainingLo, ShadowLo, bRemainingLoClosed, false });
+				}
+				if (!(ShadowHi < RemainingLo))
+				{
+					RemainingLo = ShadowHi;
+					bRemainingLoClosed = false;
+				}
+				bLit = !IsSpanEmpty(RemainingLo, bRemainingLoClosed, Span.Hi, Span.bHiClosed);
+			}
+
+			if (bLit && (Depth < MaxDepth))
+			{
+				Spans.Add({ Depth + 1, RemainingLo, Span.Hi, bRemainingLoClosed, Span.bHiClosed });
+			}
+		}
+	}
+
+	return true;
+}
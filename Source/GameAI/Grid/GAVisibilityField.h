@@ -0,0 +1,49 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameAI/Grid/GAGridActor.h"
+#include "GameAI/Grid/GAGridBitPlane.h"
+
+
+// Which cells of a box can see a single origin cell
+// Every candidate cell in a spatial query looks at the same target. So rather than walking a line from each of them,
+// we shadowcast out from the target once, and each candidate's line of sight is a single bit lookup.
+// Built by AGAGridActor::BuildVisibilityField.
+//
+// Lines run from cell centre to cell centre. A cell counts as visible exactly when FGAGridBitPlane::IsLineClear
+// would say so for those centres, corner rule included. So the field can stand in for per-cell grid LOS tests.
+
+struct FGAVisibilityField
+{
+	FCellRef Origin = FCellRef::Invalid;
+
+	// The cells covered. Anything outside the box reads as not visible.
+	FGridBox Box;
+
+	// The grid version the field was built against (see AGAGridActor::GetGridVersion)
+	uint32 GridVersion = 0;
+
+	// One bit per cell of the box, in box-local coordinates
+	FGAGridBitPlane Visible;
+
+	// Fill in the field from the given traversability. Doesn't touch any UObjects, so it can run anywhere.
+	// Cells between the origin and the box are taken into account even when the origin is outside the box.
+	// If the origin isn't traversable, nothing is visible. Returns false if the box doesn't overlap the grid.
+	bool Build(const FGAGridBitPlane& Traversable, const FCellRef& OriginIn, const FGridBox& BoxIn);
+
+	// Still the answer for this origin and box, i.e. built from them and the grid hasn't changed since
+	bool IsValidFor(const AGAGridActor* Grid, const FCellRef& OriginIn, const FGridBox& BoxIn) const
+	{
+		return (Origin == OriginIn) && (GridVersion == Grid->GetGridVersion()) &&
+			(Box.MinX == BoxIn.MinX) && (Box.MaxX == BoxIn.MaxX) && (Box.MinY == BoxIn.MinY) && (Box.MaxY == BoxIn.MaxY);
+	}
+
+	FORCEINLINE bool IsVisible(int32 X, int32 Y) const
+	{
+		return Visible.Get(X - Box.MinX, Y - Box.MinY);
+	}
+
+	FORCEINLINE bool IsVisible(const FCellRef& Cell) const { return IsVisible(Cell.X, Cell.Y); }
+
+	SIZE_T GetAllocatedSize() const { return Visible.GetAllocatedSize(); }
+};
@@ -0,0 +1,133 @@
+#include "GAVisibilitySet.h"
+#include "GAVisibilityField.h"
+#include "Async/ParallelFor.h"
+#include "Misc/Crc.h"
+#include "GameAI/GameAI.h"
+
+DECLARE_CYCLE_STAT(TEXT("GA Build Visibility Set"), STAT_GABuildVisibilitySet, STATGROUP_GameAI);
+
+
+void FGAVisibilitySet::Build(const FGAGridBitPlane& Traversable, int32 ClusterSizeIn)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GABuildVisibilitySet);
+	const double StartTime = FPlatformTime::Seconds();
+
+	Empty();
+
+	XCount = Traversable.GetXCount();
+	YCount = Traversable.GetYCount();
+	ClusterSize = FMath::Max(ClusterSizeIn, 1);
+	ClustersX = FMath::DivideAndRoundUp(XCount, ClusterSize);
+	ClustersY = FMath::DivideAndRoundUp(YCount, ClusterSize);
+
+	const int32 ClusterCount = ClustersX * ClustersY;
+	if (ClusterCount == 0)
+	{
+		return;
+	}
+	WordsPerRow = FMath::DivideAndRoundUp(ClusterCount, FGAGridBitPlane::BitsPerWord);
+
+	// Every row on its own to start with; each is written by just one task
+	TArray<uint64> FullRows;
+	FullRows.SetNumZeroed(ClusterCount * WordsPerRow);
+
+	const FGridBox AllCells(0, XCount - 1, 0, YCount - 1);
+
+	ParallelFor(ClusterCount, [&](int32 ClusterIndex)
+	{
+		const int32 MinX = (ClusterIndex % ClustersX) * ClusterSize;
+		const int32 MinY = (ClusterIndex / ClustersX) * ClusterSize;
+		const int32 MaxX = FMath::Min(MinX + ClusterSize, XCount) - 1;
+		const int32 MaxY = FMath::Min(MinY + ClusterSize, YCount) - 1;
+
+		uint64* Row = FullRows.GetData() + ClusterIndex * WordsPerRow;
+		FGAVisibilityField Field;
+
+		for (int32 Y = MinY; Y <= MaxY; Y++)
+		{
+			for (int32 X = MinX; X <= MaxX; X++)
+			{
+				if (!Traversable.Get(X, Y))
+				{
+					continue;
+				}
+
+				Field.Build(Traversable, FCellRef(X, Y), AllCells);
+
+				// OR the field into the row, a cluster at a time, skipping clusters we already know are visible
+				for (int32 Other = 0; Other < ClusterCount; Other++)
+				{
+					if ((Row[Other >> 6] >> (Other & 63)) & 1)
+					{
+						continue;
+					}
+
+					const int32 OtherMinX = (Other % ClustersX) * ClusterSize;
+					const int32 OtherMinY = (Other / ClustersX) * ClusterSize;
+					const int32 OtherMaxX = FMath::Min(OtherMinX + ClusterSize, XCount) - 1;
+					const int32 OtherMaxY = FMath::Min(OtherMinY + ClusterSize, YCount) - 1;
+					for (int32 OtherY = OtherMinY; OtherY <= OtherMaxY; OtherY++)
+					{
+						if (Field.Visible.FindFirstSetInSpan(OtherY, OtherMinX, OtherMaxX) != INDEX_NONE)
+						{
+							Row[Other >> 6] |= uint64(1) << (Other & 63);
+							break;
+						}
+					}
+				}
+			}
+		}
+	});
+
+	// Share identical rows
+	TMultiMap<uint32, int32> RowsByHash;
+	RowOfCluster.SetNumUninitialized(ClusterCount);
+	for (int32 ClusterIndex = 0; ClusterIndex < ClusterCount; ClusterIndex++)
+	{
+		const uint64* Row = FullRows.GetData() + ClusterIndex * WordsPerRow;
+		const uint32 Hash = FCrc::MemCrc32(Row, WordsPerRow * sizeof(uint64));
+
+		int32 Found = INDEX_NONE;
+		for (auto It = RowsByHash.CreateConstKeyIterator(Hash); It; ++It)
+		{
+			if (FMemory::Memcmp(Rows.GetData() + It.Value() * WordsPerRow, Row, WordsPerRow * sizeof(uint64)) == 0)
+			{
+				Found = It.Value();
+				break;
+			}
+		}
+
+		if (Found == INDEX_NONE)
+		{
+			Found = Rows.Num() / WordsPerRow;
+			Rows.Append(Row, WordsPerRow);
+			RowsByHash.Add(Hash, Found);
+		}
+		RowOfCluster[ClusterIndex] = Found;
+	}
+	Rows.Shrink();
+
+	BuildSeconds = FPlatformTime::Seconds() - StartTime;
+	LogStats();
+}
+
+
+void FGAVisibilitySet::Empty()
+{
+	XCount = 0;
+	YCount = 0;
+	ClustersX = 0;
+	ClustersY = 0;
+	WordsPerRow = 0;
+	Rows.Empty();
+	RowOfCluster.Empty();
+	BuildSeconds = 0.0;
+}
+
+
+void FGAVisibilitySet::LogStats() const
+{
+	const uint64 FullBytes = uint64(RowOfCluster.Num()) * uint64(WordsPerRow) * sizeof(uint64);
+	UE_LOG(LogTemp, Log, TEXT("Visibility set: %dx%d cells, %d clusters of %dx%d, %d unique rows, %llu bytes (%llu uncompressed), built in %.1f ms"),
+		XCount, YCount, RowOfCluster.Num(), ClusterSize, ClusterSize, GetUniqueRowCount(), uint64(GetAllocatedSize()), FullBytes, BuildSeconds * 1000.0);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GAGridBitPlane.h"
+
+
+// A baked potentially-visible set over a static grid
+// The grid is split into square clusters of ClusterSize cells, and for every pair of clusters we keep one bit: can any
+// traversable cell of one see any traversable cell of the other (centre to centre, same rules as FGAVisibilityField)?
+// A clear bit means no line of sight between any cells of the two clusters, so most LOS questions become a bit test.
+// With a cluster size of 1 the set is exact, at the price of (cells)^2 bits -- bigger clusters trade that away
+// quadratically. Visibility is symmetric, so a cluster's row is also its column.
+//
+// Rows are shared between clusters that see exactly the same set (e.g. every fully blocked cluster), so it's usually
+// a good deal smaller than the full matrix. See GetAllocatedSize.
+//
+// Baking takes a visibility field per traversable cell, so it's only for grids that don't change at runtime.
+
+class FGAVisibilitySet
+{
+public:
+	// Bake the set. Runs the rows in parallel.
+	void Build(const FGAGridBitPlane& Traversable, int32 ClusterSizeIn);
+
+	void Empty();
+
+	bool IsValidFor(int32 XCountIn, int32 YCountIn) const
+	{
+		return (XCount == XCountIn) && (YCount == YCountIn) && (RowOfCluster.Num() > 0);
+	}
+
+	// Does a bit test give the exact answer, or just rule things out?
+	bool IsExact() const { return ClusterSize == 1; }
+
+	int32 GetClusterSize() const { return ClusterSize; }
+	int32 GetClusterCount() const { return RowOfCluster.Num(); }
+	int32 GetUniqueRowCount() const { return WordsPerRow ? (Rows.Num() / WordsPerRow) : 0; }
+
+	FORCEINLINE int32 GetClusterIndex(int32 X, int32 Y) const
+	{
+		return (Y / ClusterSize) * ClustersX + (X / ClusterSize);
+	}
+
+	// Could any cell of A's cluster see any cell of B's? If not, there's definitely no line of sight between A and B.
+	// Anything off the grid is never visible.
+	FORCEINLINE bool IsPotentiallyVisible(int32 AX, int32 AY, int32 BX, int32 BY) const
+	{
+		if (!IsInGrid(AX, AY) || !IsInGrid(BX, BY))
+		{
+			return false;
+		}
+		const int32 B = GetClusterIndex(BX, BY);
+		const uint64* Row = Rows.GetData() + RowOfCluster[GetClusterIndex(AX, AY)] * WordsPerRow;
+		return (Row[B >> 6] >> (B & 63)) & 1;
+	}
+
+	SIZE_T GetAllocatedSize() const { return Rows.GetAllocatedSize() + RowOfCluster.GetAllocatedSize(); }
+
+	// Size, compression and build time
+	void LogStats() const;
+
+private:
+	FORCEINLINE bool IsInGrid(int32 X, int32 Y) const
+	{
+		return (X >= 0) && (Y >= 0) && (X < XCount) && (Y < YCount);
+	}
+
+	int32 XCount = 0;
+	int32 YCount = 0;
+	int32 ClusterSize = 1;
+	int32 ClustersX = 0;
+	int32 ClustersY = 0;
+	int32 WordsPerRow = 0;
+
+	// The distinct rows, WordsPerRow words each, bit B of a row set if cluster B is visible
+	TArray<uint64> Rows;
+
+	// Which of the rows belongs to each cluster
+	TArray<int32> RowOfCluster;
+
+	double BuildSeconds = 0.0;
+};
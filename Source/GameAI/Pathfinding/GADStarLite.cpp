@@ -0,0 +1,491 @@
+#include "GADStarLite.h"
+#include "GAGridSearch.h"
+#include "GameAI/Grid/GAJumpPointTable.h"
+#include "GameAI/GameAI.h"
+#include "Algo/Reverse.h"
+
+DECLARE_CYCLE_STAT(TEXT("GA D* Lite"), STAT_GADStarLite, STATGROUP_GameAI);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("GA D* Lite Cells Expanded"), STAT_GADStarLiteExpanded, STATGROUP_GameAI);
+
+
+bool FGADStarLite::FindPath(const AGAGridActor* GridIn, const FCellRef& StartCell, const FCellRef& GoalCell, uint8 MinClearanceIn, TArray<FCellRef>& PathOut)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GADStarLite);
+
+	PathOut.Reset();
+	ExpandedCount = 0;
+
+	// Nothing to be done about another region, and no point growing a tree over our whole region to find that out
+	if (!GridIn || !GridIn->AreConnected(StartCell, GoalCell))
+	{
+		return false;
+	}
+
+	// Same as FGAGridSearch: the two ends have to be traversable (but needn't have the clearance). Check before touching
+	// the tree, so a bad query can't cost us the tree we've got.
+	if (!GridIn->IsTraversable(StartCell.X, StartCell.Y) || !GridIn->IsTraversable(GoalCell.X, GoalCell.Y))
+	{
+		return false;
+	}
+
+	if (StartCell == GoalCell)
+	{
+		PathOut.Add(StartCell);
+		return true;
+	}
+
+	const bool bSameGrid = (Grid == GridIn) && (XCount == GridIn->XCount) && (YCount == GridIn->YCount) && (MinClearance == MinClearanceIn);
+	Grid = GridIn;
+	MinClearance = MinClearanceIn;
+
+	// If the agent isn't on the settled part of the tree there's nothing worth keeping, so go straight to a fresh tree
+	// rather than paying for an incremental pass first
+	const bool bFresh = !bSameGrid || !Root.IsValid() || ((StartCell != Root) && !Reroot(StartCell));
+	if (bFresh)
+	{
+		Restart(StartCell, GoalCell);
+	}
+	else
+	{
+		ApplyGridChanges();
+
+		// The destination moving is the search start moving, as far as the tree is concerned
+		if (Goal != GoalCell)
+		{
+			const int32 OldGoalIndex = Goal.Y * XCount + Goal.X;
+			KM += FGAGridSearch::OctileDistance(GoalCell.X - Goal.X, GoalCell.Y - Goal.Y);
+			Goal = GoalCell;
+
+			// The clearance exemption goes with it
+			UpdateAround(OldGoalIndex);
+			UpdateAround(Goal.Y * XCount + Goal.X);
+		}
+	}
+
+	const int32 GoalIndex = Goal.Y * XCount + Goal.X;
+	const bool bComputed = ComputeShortestPath();
+	if (bComputed && ((GetG(GoalIndex) == Infinity) || ExtractPath(PathOut)))
+	{
+		// Either we've got the path, or the goal really can't be reached (with our clearance)
+		INC_DWORD_STAT_BY(STAT_GADStarLiteExpanded, ExpandedCount);
+		return PathOut.Num() > 0;
+	}
+
+	// The backstop: if the repaired tree let us down, a fresh one won't
+	if (!bFresh)
+	{
+		const int32 FirstExpandedCount = ExpandedCount;
+		Restart(StartCell, GoalCell);
+		ComputeShortestPath();
+		ExpandedCount += FirstExpandedCount;
+	}
+	INC_DWORD_STAT_BY(STAT_GADStarLiteExpanded, ExpandedCount);
+
+	return (GetG(GoalIndex) < Infinity) && ExtractPath(PathOut);
+}
+
+
+void FGADStarLite::Reset()
+{
+	Grid = nullptr;
+	Root = FCellRef::Invalid;
+	Goal = FCellRef::Invalid;
+	Open.Reset();
+}
+
+
+void FGADStarLite::Restart(const FCellRef& RootIn, const FCellRef& GoalIn)
+{
+	XCount = Grid->XCount;
+	YCount = Grid->YCount;
+	GridVersion = Grid->GetGridVersion();
+
+	const int32 CellCount = XCount * YCount;
+	if ((Stamp.Num() != CellCount) || (Generation == MAX_uint32))
+	{
+		Stamp.SetNumUninitialized(CellCount);
+		FMemory::Memzero(Stamp.GetData(), CellCount * sizeof(uint32));
+		G.SetNumUninitialized(CellCount);
+		Rhs.SetNumUninitialized(CellCount);
+		Parent.SetNumUninitialized(CellCount);
+		QueuedKey.SetNumUninitialized(CellCount);
+		Generation = 0;
+	}
+	Generation++;
+
+	Open.Reset();
+	Root = RootIn;
+	Goal = GoalIn;
+	KM = 0.0f;
+
+	const int32 RootIndex = Root.Y * XCount + Root.X;
+	Touch(RootIndex);
+	Rhs[RootIndex] = 0.0f;
+	Push(RootIndex);
+}
+
+
+bool FGADStarLite::Reroot(const FCellRef& NewRoot)
+{
+	const int32 NewRootIndex = NewRoot.Y * XCount + NewRoot.X;
+	if ((Stamp[NewRootIndex] != Generation) || (G[NewRootIndex] == Infinity) || (G[NewRootIndex] != Rhs[NewRootIndex]) || (Generation == MAX_uint32))
+	{
+		return false;
+	}
+
+	// Gather everything hanging off the new root. Each cell has one parent, so nothing gets added twice.
+	Subtree.Reset();
+	Subtree.Add(NewRootIndex);
+	for (int32 SubtreeIndex = 0; SubtreeIndex < Subtree.Num(); SubtreeIndex++)
+	{
+		const int32 CellIndex = Subtree[SubtreeIndex];
+		const int32 X = CellIndex % XCount;
+		const int32 Y = CellIndex / XCount;
+		for (int32 Direction = 0; Direction < 8; Direction++)
+		{
+			const int32 NX = X + FGAJumpPointTable::DirectionDX[Direction];
+			const int32 NY = Y + FGAJumpPointTable::DirectionDY[Direction];
+			if ((NX < 0) || (NY < 0) || (NX >= XCount) || (NY >= YCount))
+			{
+				continue;
+			}
+
+			const int32 NeighborIndex = NY * XCount + NX;
+			if ((NeighborIndex != NewRootIndex) && (Stamp[NeighborIndex] == Generation) && (Parent[NeighborIndex] == CellIndex))
+			{
+				Subtree.Add(NeighborIndex);
+			}
+		}
+	}
+
+	// Keep the subtree, and drop everything else by moving on a generation. The new root keeps its G (and Rhs): every
+	// G in the subtree is out by that much, but keys only get compared with each other, so that's fine.
+	const int32 OldRootIndex = Root.Y * XCount + Root.X;
+	Generation++;
+	for (const int32 CellIndex : Subtree)
+	{
+		Stamp[CellIndex] = Generation;
+	}
+	Root = NewRoot;
+	Parent[NewRootIndex] = INDEX_NONE;
+
+	Open.RemoveAll([this](const FEntry& Entry)
+	{
+		return (Stamp[Entry.CellIndex] != Generation) || !(QueuedKey[Entry.CellIndex] == Entry.Key);
+	});
+	Open.Heapify(FEntryPredicate());
+
+	// The cells just outside the subtree can be reached from it again
+	for (const int32 CellIndex : Subtree)
+	{
+		const int32 X = CellIndex % XCount;
+		const int32 Y = CellIndex / XCount;
+		for (int32 Direction = 0; Direction < 8; Direction++)
+		{
+			const int32 NX = X + FGAJumpPointTable::DirectionDX[Direction];
+			const int32 NY = Y + FGAJumpPointTable::DirectionDY[Direction];
+			if ((NX >= 0) && (NY >= 0) && (NX < XCount) && (NY < YCount) && (Stamp[NY * XCount + NX] != Generation))
+			{
+				UpdateVertex(NY * XCount + NX);
+			}
+		}
+	}
+
+	// The clearance exemption has moved from the old root to the new one
+	UpdateAround(OldRootIndex);
+	UpdateAround(NewRootIndex);
+
+	return true;
+}
+
+
+void FGADStarLite::ApplyGridChanges()
+{
+	const uint32 NewVersion = Grid->GetGridVersion();
+	if (NewVersion == GridVersion)
+	{
+		return;
+	}
+
+	// Every step into or out of a changed cell (or diagonally past one) starts within a cell of it, so re-checking
+	// each changed region plus a one cell border covers every cost that can have changed
+	const int32 RegionSize = AGAGridActor::VersionRegionSize;
+	for (int32 RegionY = 0; RegionY < YCount; RegionY += RegionSize)
+	{
+		for (int32 RegionX = 0; RegionX < XCount; RegionX += RegionSize)
+		{
+			if (Grid->GetRegionVersion(FCellRef(RegionX, RegionY)) <= GridVersion)
+			{
+				continue;
+			}
+
+			const int32 MinX = FMath::Max(RegionX - 1, 0);
+			const int32 MaxX = FMath::Min(RegionX + RegionSize, XCount - 1);
+			const int32 MinY = FMath::Max(RegionY - 1, 0);
+			const int32 MaxY = FMath::Min(RegionY + RegionSize, YCount - 1);
+			for (int32 Y = MinY; Y <= MaxY; Y++)
+			{
+				for (int32 X = MinX; X <= MaxX; X++)
+				{
+					UpdateVertex(Y * XCount + X);
+				}
+			}
+		}
+	}
+
+	GridVersion = NewVersion;
+}
+
+
+bool FGADStarLite::ComputeShortestPath()
+{
+	const int32 GoalIndex = Goal.Y * XCount + Goal.X;
+
+	// Every cell can only settle a bounded number of times per change, so this is just a backstop
+	const int32 MaxExpansions = 8 * XCount * YCount;
+
+	while (true)
+	{
+		CleanTop();
+		if (Open.Num() == 0)
+		{
+			break;
+		}
+
+		// The cells on the best path have the same K1 as the goal, give or take float rounding, so within a tolerance
+		// let K2 decide. Otherwise we can stop just short of them and not be able to read the path back.
+		const FEntry Top = Open.HeapTop();
+		const FKey GoalKey = CalculateKey(GoalIndex);
+		const float Tolerance = KINDA_SMALL_NUMBER * FMath::Max(1.0f, (GoalKey.K1 < Infinity) ? GoalKey.K1 : 1.0f);
+		const bool bAheadOfGoal = (Top.Key.K1 < GoalKey.K1 - Tolerance) || ((Top.Key.K1 <= GoalKey.K1 + Tolerance) && (Top.Key.K2 < GoalKey.K2));
+		if (!bAheadOfGoal && (GetRhs(GoalIndex) == GetG(GoalIndex)))
+		{
+			break;
+		}
+
+		FEntry Entry;
+		Open.HeapPop(Entry, FEntryPredicate(), false);
+		const int32 CellIndex = Entry.CellIndex;
+		QueuedKey[CellIndex].K1 = Infinity;
+
+		// The key's gone up since it was queued (KM has moved on), so put it back where it belongs
+		const FKey NewKey = CalculateKey(CellIndex);
+		if (Entry.Key < NewKey)
+		{
+			Push(CellIndex);
+			continue;
+		}
+
+		if (++ExpandedCount > MaxExpansions)
+		{
+			return false;
+		}
+
+		const int32 X = CellIndex % XCount;
+		const int32 Y = CellIndex / XCount;
+		if (G[CellIndex] > Rhs[CellIndex])
+		{
+			// Got shorter: settle it
+			G[CellIndex] = Rhs[CellIndex];
+		}
+		else
+		{
+			// Got longer: forget it, and let it (and everything that went through it) find a new way
+			G[CellIndex] = Infinity;
+			UpdateVertex(CellIndex);
+		}
+
+		for (int32 Direction = 0; Direction < 8; Direction++)
+		{
+			const int32 NX = X + FGAJumpPointTable::DirectionDX[Direction];
+			const int32 NY = Y + FGAJumpPointTable::DirectionDY[Direction];
+			if ((NX >= 0) && (NY >= 0) && (NX < XCount) && (NY < YCount))
+			{
+				UpdateVertex(NY * XCount + NX);
+			}
+		}
+	}
+
+	return true;
+}
+
+
+void FGADStarLite::UpdateVertex(int32 CellIndex)
+{
+	Touch(CellIndex);
+
+	const int32 X = CellIndex % XCount;
+	const int32 Y = CellIndex / XCount;
+	if ((X != Root.X) || (Y != Root.Y))
+	{
+		float Best = Infinity;
+		int32 BestParent = INDEX_NONE;
+		for (int32 Direction = 0; Direction < 8; Direction++)
+		{
+			const float StepCost = GetStepCost(X, Y, Direction);
+			if (StepCost == Infinity)
+			{
+				continue;
+			}
+
+			const int32 NeighborIndex = (Y + FGAJumpPointTable::DirectionDY[Direction]) * XCount + X + FGAJumpPointTable::DirectionDX[Direction];
+			const float NeighborG = GetG(NeighborIndex);
+			if ((NeighborG < Infinity) && (NeighborG + StepCost < Best))
+			{
+				Best = NeighborG + StepCost;
+				BestParent = NeighborIndex;
+			}
+		}
+		Rhs[CellIndex] = Best;
+		Parent[CellIndex] = BestParent;
+	}
+
+	if (G[CellIndex] != Rhs[CellIndex])
+	{
+		Push(CellIndex);
+	}
+	else
+	{
+		// Consistent, so whatever entry it had is dead
+		QueuedKey[CellIndex].K1 = Infinity;
+	}
+}
+
+
+void FGADStarLite::UpdateAround(int32 CellIndex)
+{
+	const int32 X = CellIndex % XCount;
+	const int32 Y = CellIndex / XCount;
+	for (int32 NY = FMath::Max(Y - 1, 0); NY <= FMath::Min(Y + 1, YCount - 1); NY++)
+	{
+		for (int32 NX = FMath::Max(X - 1, 0); NX <= FMath::Min(X + 1, XCount - 1); NX++)
+		{
+			UpdateVertex(NY * XCount + NX);
+		}
+	}
+}
+
+
+bool FGADStarLite::ExtractPath(TArray<FCellRef>& PathOut) const
+{
+	// Steps are symmetric, so the best way back from the goal to the root (the agent) is also the best way there.
+	// Only step onto consistent cells, anything else may have a G that's out of date.
+	PathOut.Reset();
+	FCellRef Cell = Goal;
+	PathOut.Add(Cell);
+
+	int32 StepsLeft = XCount * YCount;
+	while (Cell != Root)
+	{
+		float Best = Infinity;
+		FCellRef BestCell = FCellRef::Invalid;
+		for (int32 Direction = 0; Direction < 8; Direction++)
+		{
+			const float StepCost = GetStepCost(Cell.X, Cell.Y, Direction);
+			if (StepCost == Infinity)
+			{
+				continue;
+			}
+
+			const FCellRef Neighbor(Cell.X + FGAJumpPointTable::DirectionDX[Direction], Cell.Y + FGAJumpPointTable::DirectionDY[Direction]);
+			const int32 NeighborIndex = Neighbor.Y * XCount + Neighbor.X;
+			const float NeighborG = GetG(NeighborIndex);
+			if ((NeighborG == Infinity) || (NeighborG != GetRhs(NeighborIndex)))
+			{
+				continue;
+			}
+
+			if (NeighborG + StepCost < Best)
+			{
+				Best = NeighborG + StepCost;
+				BestCell = Neighbor;
+			}
+		}
+
+		if (!BestCell.IsValid() || (--StepsLeft < 0))
+		{
+			PathOut.Reset();
+			return false;
+		}
+
+		Cell = BestCell;
+		PathOut.Add(Cell);
+	}
+
+	Algo::Reverse(PathOut);
+	return true;
+}
+
+
+FGADStarLite::FKey FGADStarLite::CalculateKey(int32 CellIndex) const
+{
+	const float MinG = FMath::Min(GetG(CellIndex), GetRhs(CellIndex));
+	if (MinG == Infinity)
+	{
+		return { Infinity, Infinity };
+	}
+
+	const int32 X = CellIndex % XCount;
+	const int32 Y = CellIndex / XCount;
+	return { MinG + FGAGridSearch::OctileDistance(X - Goal.X, Y - Goal.Y) + KM, MinG };
+}
+
+
+void FGADStarLite::Push(int32 CellIndex)
+{
+	const FKey Key = CalculateKey(CellIndex);
+	QueuedKey[CellIndex] = Key;
+	Open.HeapPush({ CellIndex, Key }, FEntryPredicate());
+}
+
+
+void FGADStarLite::CleanTop()
+{
+	while (Open.Num() > 0)
+	{
+		const FEntry& Top = Open.HeapTop();
+		if ((Stamp[Top.CellIndex] == Generation) && (QueuedKey[Top.CellIndex] == Top.Key))
+		{
+			return;
+		}
+		Open.HeapPopDiscard(FEntryPredicate(), false);
+	}
+}
+
+
+bool FGADStarLite::IsPassable(int32 X, int32 Y) const
+{
+	if (!Grid->IsTraversable(X, Y))
+	{
+		return false;
+	}
+	if ((MinClearance <= 1) || (Grid->GetClearance(X, Y) >= MinClearance))
+	{
+		return true;
+	}
+
+	// The agent's and the destination's cells only have to be traversable
+	return ((X == Root.X) && (Y == Root.Y)) || ((X == Goal.X) && (Y == Goal.Y));
+}
+
+
+float FGADStarLite::GetStepCost(int32 X, int32 Y, int32 Direction) const
+{
+	const int32 DX = FGAJumpPointTable::DirectionDX[Direction];
+	const int32 DY = FGAJumpPointTable::DirectionDY[Direction];
+	if (!IsPassable(X, Y) || !IsPassable(X + DX, Y + DY))
+	{
+		return Infinity;
+	}
+
+	if (FGAJumpPointTable::IsDiagonal(Direction))
+	{
+		// No cutting corners
+		if (!IsPassable(X + DX, Y) || !IsPassable(X, Y + DY))
+		{
+			return Infinity;
+		}
+		return FGAGridSearch::DiagonalCost;
+	}
+	return FGAGridSearch::StraightCost;
+}
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameAI/Grid/GAGridActor.h"
+
+
+// Incremental planner for chasing a moving destination: D* Lite (Koenig & Likhachev), with the search tree rooted
+// at the agent rather than the goal
+// Each cell's G is its path distance from the root. When the destination moves, we keep the tree and just bump KM
+// by how far it moved (the usual D* Lite trick for a moving search start), so the queue stays valid without being
+// re-keyed. When cells change, only the cells in the changed regions get their costs re-checked (see
+// AGAGridActor::GetRegionVersion), and only what actually depends on them gets repaired. So a replan costs about
+// as much as what changed, rather than the length of the path.
+//
+// As the agent walks the path we re-root the tree at its new cell, the way Moving-Target D* Lite (Sun, Koenig & Yeoh)
+// does: the subtree hanging off the agent's cell is kept as it is (its G values are all out by the same distance walked,
+// which doesn't matter), everything else is thrown away in one go by bumping the generation, and only the cells on the
+// edge of what's kept get queued. So the tree always has the agent as its root, and the path is read back from the
+// destination to the root.
+//
+// The fallback is a fresh tree from the agent's cell, and it's always correct. We take it up front, before doing any
+// incremental work, when the agent isn't on the settled part of the tree (pushed, or it took a shortcut), and as a
+// backstop if the incremental search gives up or the path can't be read back.
+//
+// With a minimum clearance, the agent's and the destination's cells only have to be traversable, same as FGAGridSearch.
+//
+// Same movement rules as FGAGridSearch: 8-connected, octile costs, no corner cutting.
+
+class FGADStarLite
+{
+public:
+	// Plan from StartCell to GoalCell, reusing as much of the last plan as we can
+	// On success PathOut holds the cells of the path, starting with StartCell and ending with GoalCell.
+	// Fails straight away (without touching the tree) if either cell isn't traversable, or they're in different regions.
+	bool FindPath(const AGAGridActor* GridIn, const FCellRef& StartCell, const FCellRef& GoalCell, uint8 MinClearanceIn, TArray<FCellRef>& PathOut);
+
+	// Throw the tree away. The next FindPath starts from scratch.
+	void Reset();
+
+	// Number of cells expanded by the last FindPath. Handy for profiling.
+	int32 GetExpandedCount() const { return ExpandedCount; }
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return Stamp.GetAllocatedSize() + G.GetAllocatedSize() + Rhs.GetAllocatedSize() + Parent.GetAllocatedSize() + QueuedKey.GetAllocatedSize() +
+			Open.GetAllocatedSize() + Subtree.GetAllocatedSize();
+	}
+
+private:
+	struct FKey
+	{
+		float K1;
+		float K2;
+
+		bool operator<(const FKey& Other) const { return (K1 < Other.K1) || ((K1 == Other.K1) && (K2 < Other.K2)); }
+		bool operator==(const FKey& Other) const { return (K1 == Other.K1) && (K2 == Other.K2); }
+	};
+
+	// An entry in the open list. Lazy deletion again: an entry only counts while its key is still the cell's QueuedKey.
+	struct FEntry
+	{
+		int32 CellIndex;
+		FKey Key;
+	};
+
+	struct FEntryPredicate
+	{
+		FORCEINLINE bool operator()(const FEntry& A, const FEntry& B) const { return A.Key < B.Key; }
+	};
+
+	static constexpr float Infinity = TNumericLimits<float>::Max();
+
+	// Start a new tree rooted at RootIn
+	void Restart(const FCellRef& RootIn, const FCellRef& GoalIn);
+
+	// Move the root to NewRoot, keeping the part of the tree below it. False if NewRoot isn't settled on the tree.
+	bool Reroot(const FCellRef& NewRoot);
+
+	// Re-check the cells of every region that's changed since we last looked
+	void ApplyGridChanges();
+
+	// False if it hit the backstop on the number of expansions
+	bool ComputeShortestPath();
+
+	// Recompute the cell's Rhs (and Parent) from its neighbours, and queue it if that leaves it inconsistent
+	void UpdateVertex(int32 CellIndex);
+
+	// UpdateVertex the cell and its eight neighbours
+	void UpdateAround(int32 CellIndex);
+
+	// Walk back from the goal to the root, false if we can't get there
+	bool ExtractPath(TArray<FCellRef>& PathOut) const;
+
+	FKey CalculateKey(int32 CellIndex) const;
+
+	void Push(int32 CellIndex);
+
+	// Drop any dead entries off the top of the open list
+	void CleanTop();
+
+	bool IsPassable(int32 X, int32 Y) const;
+
+	// Cost of the step from (X, Y) in the given direction, Infinity if it can't be taken
+	float GetStepCost(int32 X, int32 Y, int32 Direction) const;
+
+	// Cells we haven't touched since the last Restart read as G = Rhs = Infinity, and not queued
+	FORCEINLINE void Touch(int32 CellIndex)
+	{
+		if (Stamp[CellIndex] != Generation)
+		{
+			Stamp[CellIndex] = Generation;
+			G[CellIndex] = Infinity;
+			Rhs[CellIndex] = Infinity;
+			Parent[CellIndex] = INDEX_NONE;
+			QueuedKey[CellIndex] = { Infinity, Infinity };
+		}
+	}
+
+	FORCEINLINE float GetG(int32 CellIndex) const { return (Stamp[CellIndex] == Generation) ? G[CellIndex] : Infinity; }
+	FORCEINLINE float GetRhs(int32 CellIndex) const { return (Stamp[CellIndex] == Generation) ? Rhs[CellIndex] : Infinity; }
+
+	// Only used to notice a different grid, never dereferenced outside FindPath
+	const AGAGridActor* Grid = nullptr;
+	int32 XCount = 0;
+	int32 YCount = 0;
+	uint8 MinClearance = 0;
+
+	FCellRef Root;
+	FCellRef Goal;
+	float KM = 0.0f;
+
+	// The grid version the tree is up to date with
+	uint32 GridVersion = 0;
+
+	uint32 Generation = 0;
+	TArray<uint32> Stamp;
+	TArray<float> G;
+	TArray<float> Rhs;
+	TArray<int32> Parent;		// the neighbour the cell's Rhs came from, so we can find a subtree when re-rooting
+	TArray<FKey> QueuedKey;		// the key of the cell's live open list entry, K1 = Infinity if it hasn't got one
+	TArray<FEntry> Open;
+	TArray<int32> Subtree;		// scratch for Reroot
+
+	int32 ExpandedCount = 0;
+};
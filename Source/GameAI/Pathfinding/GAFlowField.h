@@ -0,0 +1,76 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameAI/Grid/GAGridActor.h"
+#include "GameAI/Grid/GAJumpPointTable.h"
+
+
+// A flow field towards a single goal cell
+// For every cell of the grid we store which way to step to get closer to the goal (one byte per cell), so any number
+// of agents heading for the same goal can each find their next cell with a single lookup, instead of each running
+// their own search. Built by FGAGridSearch::BuildFlowField, and usually shared via the UGAFlowFieldSubsystem.
+//
+// Directions use the same numbering as the searches (see FGAJumpPointTable::DirectionDX/DY).
+
+struct FGAFlowField
+{
+	// The cell can't reach the goal (or isn't traversable)
+	static constexpr uint8 Unreachable = 0xFF;
+
+	// The cell is the goal
+	static constexpr uint8 AtGoal = 0xFE;
+
+	FCellRef GoalCell = FCellRef::Invalid;
+
+	// The grid version the field was built against (see AGAGridActor::GetGridVersion)
+	uint32 GridVersion = 0;
+
+	int32 XCount = 0;
+	int32 YCount = 0;
+
+	TArray<uint8> Directions;
+
+	bool IsValidFor(const AGAGridActor* Grid) const
+	{
+		return (XCount == Grid->XCount) && (YCount == Grid->YCount) && (GridVersion == Grid->GetGridVersion()) && (Directions.Num() == XCount * YCount);
+	}
+
+	FORCEINLINE uint8 GetDirection(const FCellRef& Cell) const
+	{
+		if ((Cell.X < 0) || (Cell.Y < 0) || (Cell.X >= XCount) || (Cell.Y >= YCount))
+		{
+			return Unreachable;
+		}
+		return Directions[Cell.Y * XCount + Cell.X];
+	}
+
+	// The next cell on the way to the goal. The goal cell maps to itself, and unreachable cells to FCellRef::Invalid.
+	FORCEINLINE FCellRef GetNextCell(const FCellRef& Cell) const
+	{
+		const uint8 Direction = GetDirection(Cell);
+		if (Direction == AtGoal)
+		{
+			return Cell;
+		}
+		if (Direction == Unreachable)
+		{
+			return FCellRef::Invalid;
+		}
+		return FCellRef(Cell.X + FGAJumpPointTable::DirectionDX[Direction], Cell.Y + FGAJumpPointTable::DirectionDY[Direction]);
+	}
+
+	// Direction index of a single step, for writing the field
+	static uint8 GetDirectionIndex(int32 DX, int32 DY)
+	{
+		for (uint8 Direction = 0; Direction < 8; Direction++)
+		{
+			if ((FGAJumpPointTable::DirectionDX[Direction] == DX) && (FGAJumpPointTable::DirectionDY[Direction] == DY))
+			{
+				return Direction;
+			}
+		}
+		return Unreachable;
+	}
+
+	SIZE_T GetAllocatedSize() const { return Directions.GetAllocatedSize(); }
+};
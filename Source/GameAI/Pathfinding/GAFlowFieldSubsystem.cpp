@@ -0,0 +1,69 @@
+#include "GAFlowFieldSubsystem.h"
+
+
+const FGAFlowField* UGAFlowFieldSubsystem::GetFlowField(const AGAGridActor* Grid, const FCellRef& GoalCell)
+{
+	if (!Grid || !GoalCell.IsValid())
+	{
+		return nullptr;
+	}
+
+	UseCounter++;
+
+	// Only a handful of fields, so a linear search is fine
+	FCachedField* Entry = nullptr;
+	for (const TUniquePtr<FCachedField>& Cached : Fields)
+	{
+		if (Cached->Field.GoalCell == GoalCell)
+		{
+			Entry = Cached.Get();
+			break;
+		}
+	}
+
+	if (Entry && Entry->Field.IsValidFor(Grid))
+	{
+		Entry->LastUsed = UseCounter;
+		return (Entry->Field.GetDirection(GoalCell) == FGAFlowField::AtGoal) ? &Entry->Field : nullptr;
+	}
+
+	if (!Entry)
+	{
+		// Make room by evicting the least recently used field
+		if (Fields.Num() >= FMath::Max(MaxCachedFields, 1))
+		{
+			int32 OldestIndex = 0;
+			for (int32 Index = 1; Index < Fields.Num(); Index++)
+			{
+				if (Fields[Index]->LastUsed < Fields[OldestIndex]->LastUsed)
+				{
+					OldestIndex = Index;
+				}
+			}
+			Fields.RemoveAtSwap(OldestIndex);
+		}
+
+		Entry = Fields.Add_GetRef(MakeUnique<FCachedField>()).Get();
+	}
+
+	// Either new, or built against an older version of the grid
+	Entry->LastUsed = UseCounter;
+	return Search.BuildFlowField(Grid, GoalCell, Entry->Field) ? &Entry->Field : nullptr;
+}
+
+
+void UGAFlowFieldSubsystem::Flush()
+{
+	Fields.Empty();
+}
+
+
+SIZE_T UGAFlowFieldSubsystem::GetAllocatedSize() const
+{
+	SIZE_T Result = Fields.GetAllocatedSize();
+	for (const TUniquePtr<FCachedField>& Cached : Fields)
+	{
+		Result += sizeof(FCachedField) + Cached->Field.GetAllocatedSize();
+	}
+	return Result;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GAFlowField.h"
+#include "GAGridSearch.h"
+#include "GAFlowFieldSubsystem.generated.h"
+
+
+// Builds and caches flow fields, so that every agent heading for the same goal shares one
+// Fields are keyed by goal cell, and are rebuilt when the grid version moves on (i.e. whenever the grid's traversability
+// changes). Only the most recently used MaxCachedFields fields are kept.
+
+UCLASS()
+class UGAFlowFieldSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// The flow field towards GoalCell, building it if need be. Null if the goal isn't traversable.
+	// Note the pointer is only good until the next call, since that might evict or rebuild the field.
+	const FGAFlowField* GetFlowField(const AGAGridActor* Grid, const FCellRef& GoalCell);
+
+	// Drop all cached fields
+	void Flush();
+
+	SIZE_T GetAllocatedSize() const;
+
+	// Each field is a byte per grid cell, so keep this modest on big grids
+	int32 MaxCachedFields = 8;
+
+private:
+	struct FCachedField
+	{
+		FGAFlowField Field;
+		uint64 LastUsed = 0;
+	};
+
+	TArray<TUniquePtr<FCachedField>> Fields;
+
+	uint64 UseCounter = 0;
+
+	FGAGridSearch Search;
+};
@@ -0,0 +1,912 @@
+#include "GAGridSearch.h"
+#include "GAFlowField.h"
+#include "GameAI/GameAI.h"
+#include "Algo/Reverse.h"
+
+DECLARE_CYCLE_STAT(TEXT("GA Dijkstra"), STAT_GADijkstra, STATGROUP_GameAI);
+DECLARE_CYCLE_STAT(TEXT("GA AStar"), STAT_GAAStar, STATGROUP_GameAI);
+
+
+DECLARE_CYCLE_STAT(TEXT("GA Jump Point Search"), STAT_GAJumpPointSearch, STATGROUP_GameAI);
+DECLARE_CYCLE_STAT(TEXT("GA Hierarchical Search"), STAT_GAHierarchicalSearch, STATGROUP_GameAI);
+DECLARE_CYCLE_STAT(TEXT("GA Build Flow Field"), STAT_GABuildFlowField, STATGROUP_GameAI);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("GA Cells Expanded"), STAT_GACellsExpanded, STATGROUP_GameAI);
+
+
+// The 8 neighbour directions. The first four are the straight ones, the last four the diagonals.
+static const int32* NeighborDX = FGAJumpPointTable::DirectionDX;
+static const int32* NeighborDY = FGAJumpPointTable::DirectionDY;
+
+
+static FORCEINLINE bool IsTraversable(const AGAGridActor* Grid, int32 X, int32 Y)
+{
+	return Grid->IsTraversable(X, Y);
+}
+
+// Which cells a query may use: any traversable cell, or if there's a minimum clearance, just the cells with at least that much
+// Either way it's one test per cell.
+// The ends of the query (ExemptA/B, as cell indices) only ever need to be traversable. An agent brushing past a wall, or a
+// goal right up against one, has less clearance than the cells around it, and we still want to get out of or into it.
+struct FGAPassability
+{
+	FGAPassability(const FGAGridBitPlane& TraversableIn, const TArray<uint8>& ClearanceIn, uint8 MinClearanceIn, int32 ExemptAIn = INDEX_NONE, int32 ExemptBIn = INDEX_NONE)
+		: Traversable(TraversableIn)
+		, Clearance(nullptr)
+		, XCount(TraversableIn.GetXCount())
+		, YCount(TraversableIn.GetYCount())
+		, MinClearance(MinClearanceIn)
+		, ExemptA(ExemptAIn)
+		, ExemptB(ExemptBIn)
+	{
+		// Clearance 1 is just "traversable", and the bits are the cheaper way to ask that
+		if ((MinClearance > 1) && (ClearanceIn.Num() == XCount * YCount))
+		{
+			Clearance = ClearanceIn.GetData();
+		}
+	}
+
+	FORCEINLINE bool operator()(int32 X, int32 Y) const
+	{
+		if (!Clearance)
+		{
+			return Traversable.Get(X, Y);
+		}
+		if ((X < 0) || (Y < 0) || (X >= XCount) || (Y >= YCount))
+		{
+			return false;
+		}
+
+		const int32 Index = Y * XCount + X;
+		return (Clearance[Index] >= MinClearance) || (((Index == ExemptA) || (Index == ExemptB)) && Traversable.Get(X, Y));
+	}
+
+	const FGAGridBitPlane& Traversable;
+	const uint8* Clearance;
+	int32 XCount;
+	int32 YCount;
+	uint8 MinClearance;
+	int32 ExemptA;
+	int32 ExemptB;
+};
+
+static FORCEINLINE bool IsTraversable(const FGAPassability& Passability, int32 X, int32 Y)
+{
+	return Passability(X, Y);
+}
+
+
+// For JPS+: which directions are worth trying, given the direction we arrived in
+// Straight: everything but the three directions pointing back the way we came. Diagonal: just the diagonal and its two components.
+static uint8 GetJumpDirectionMask(uint8 ArrivalDirection)
+{
+	static const uint8 Masks[8] = {
+		0xFF & ~((1 << 1) | (1 << 5) | (1 << 7)),		// E: not W, NW, SW
+		0xFF & ~((1 << 0) | (1 << 4) | (1 << 6)),		// W: not E, NE, SE
+		0xFF & ~((1 << 3) | (1 << 6) | (1 << 7)),		// +Y: not -Y, or the two -Y diagonals
+		0xFF & ~((1 << 2) | (1 << 4) | (1 << 5)),		// -Y: not +Y, or the two +Y diagonals
+		(1 << 4) | (1 << 0) | (1 << 2),					// +X+Y
+		(1 << 5) | (1 << 1) | (1 << 2),					// -X+Y
+		(1 << 6) | (1 << 0) | (1 << 3),					// +X-Y
+		(1 << 7) | (1 << 1) | (1 << 3),					// -X-Y
+	};
+	return (ArrivalDirection < 8) ? Masks[ArrivalDirection] : 0xFF;
+}
+
+
+void FGAGridSearch::BeginQuery(int32 XCountIn, int32 YCountIn)
+{
+	int32 CellCount = XCountIn * YCountIn;
+
+	if ((XCountIn != XCount) || (YCountIn != YCount) || (Cost.Num() != CellCount))
+	{
+		XCount = XCountIn;
+		YCount = YCountIn;
+
+		Cost.SetNumUninitialized(CellCount);
+		Parent.SetNumUninitialized(CellCount);
+		ArrivalDirection.SetNumUninitialized(CellCount);
+		OpenStamp.SetNumZeroed(CellCount);
+		ClosedStamp.SetNumZeroed(CellCount);
+		Generation = 0;
+	}
+
+	Generation++;
+	if (Generation == 0)
+	{
+		// Wrapped around -- stale stamps could now look current, so clear them for real (once every 4 billion queries)
+		FMemory::Memzero(OpenStamp.GetData(), CellCount * sizeof(uint32));
+		FMemory::Memzero(ClosedStamp.GetData(), CellCount * sizeof(uint32));
+		Generation = 1;
+	}
+
+	Open.Reset();
+	ExpandedCount = 0;
+
+	// Any sliced A* in progress is gone now
+	SliceGoalIndex = INDEX_NONE;
+}
+
+
+bool FGAGridSearch::Dijkstra(const AGAGridActor* Grid, const FCellRef& StartCell, FGAGridMap& DistanceMapOut, TArray<FGASparseCell>* ReachableOut)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GADijkstra);
+
+	const FGridBox& Bounds = DistanceMapOut.GridBounds;
+
+	if (!Grid || !DistanceMapOut.IsFloatValid() || !Bounds.IsValidCell(StartCell))
+	{
+		return false;
+	}
+
+	const FGAPassability Passability(Grid->GetTraversableBits(), Grid->GetClearanceField(), MinClearance, Grid->CellRefToIndex(StartCell));
+	if (!IsTraversable(Passability, StartCell.X, StartCell.Y))
+	{
+		return false;
+	}
+
+	// The grid data had better be in sync with the dimensions
+	check(Grid->Data.Num() == Grid->XCount * Grid->YCount);
+
+	BeginQuery(Grid);
+
+	if (ReachableOut)
+	{
+		ReachableOut->Reset();
+	}
+
+	const FGASearchNodePredicate Predicate;
+
+	int32 StartIndex = Grid->CellRefToIndex(StartCell);
+	Cost[StartIndex] = 0.0f;
+	Parent[StartIndex] = INDEX_NONE;
+	OpenStamp[StartIndex] = Generation;
+	Open.HeapPush(FGASearchNode(StartIndex, 0.0f), Predicate);
+
+	while (Open.Num() > 0)
+	{
+		FGASearchNode Node;
+		Open.HeapPop(Node, Predicate, false);
+
+		// Lazy deletion -- this entry was superseded by a cheaper one
+		if (IsClosed(Node.CellIndex))
+		{
+			continue;
+		}
+		ClosedStamp[Node.CellIndex] = Generation;
+		ExpandedCount++;
+
+		const int32 X = Node.CellIndex % XCount;
+		const int32 Y = Node.CellIndex / XCount;
+
+		// Settled, so the distance is final
+		const int32 MapIndex = DistanceMapOut.LocalToIndex(X - Bounds.MinX, Y - Bounds.MinY);
+		DistanceMapOut.Data[MapIndex] = Node.Cost;
+		if (ReachableOut)
+		{
+			ReachableOut->Add(FGASparseCell{ MapIndex, Node.Cost });
+		}
+
+		for (int32 Direction = 0; Direction < 8; Direction++)
+		{
+			const int32 DX = NeighborDX[Direction];
+			const int32 DY = NeighborDY[Direction];
+			const int32 NX = X + DX;
+			const int32 NY = Y + DY;
+
+			if ((NX < Bounds.MinX) || (NX > Bounds.MaxX) || (NY < Bounds.MinY) || (NY > Bounds.MaxY))
+			{
+				continue;
+			}
+			if (!IsTraversable(Passability, NX, NY))
+			{
+				continue;
+			}
+
+			float StepCost = StraightCost;
+			if (DX != 0 && DY != 0)
+			{
+				// No corner cutting
+				if (!IsTraversable(Passability, NX, Y) || !IsTraversable(Passability, X, NY))
+				{
+					continue;
+				}
+				StepCost = DiagonalCost;
+			}
+
+			const int32 NeighborIndex = NY * XCount + NX;
+			const float NewCost = Node.Cost + StepCost;
+			if (!IsOpened(NeighborIndex) || (!IsClosed(NeighborIndex) && (NewCost < Cost[NeighborIndex])))
+			{
+				OpenStamp[NeighborIndex] = Generation;
+				Cost[NeighborIndex] = NewCost;
+				Parent[NeighborIndex] = Node.CellIndex;
+				Open.HeapPush(FGASearchNode(NeighborIndex, NewCost), Predicate);
+			}
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_GACellsExpanded, ExpandedCount);
+	return true;
+}
+
+
+bool FGAGridSearch::BuildFlowField(const AGAGridActor* Grid, const FCellRef& GoalCell, FGAFlowField& FieldOut)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GABuildFlowField);
+
+	if (!Grid)
+	{
+		return false;
+	}
+
+	FieldOut.GoalCell = GoalCell;
+	FieldOut.GridVersion = Grid->GetGridVersion();
+	FieldOut.XCount = Grid->XCount;
+	FieldOut.YCount = Grid->YCount;
+	FieldOut.Directions.SetNumUninitialized(Grid->XCount * Grid->YCount);
+	FMemory::Memset(FieldOut.Directions.GetData(), FGAFlowField::Unreachable, FieldOut.Directions.Num());
+
+	if (!IsTraversable(Grid, GoalCell.X, GoalCell.Y))
+	{
+		return false;
+	}
+
+	BeginQuery(Grid);
+
+	const FGASearchNodePredicate Predicate;
+	uint8* Directions = FieldOut.Directions.GetData();
+
+	const int32 GoalIndex = Grid->CellRefToIndex(GoalCell);
+	Cost[GoalIndex] = 0.0f;
+	Parent[GoalIndex] = INDEX_NONE;
+	OpenStamp[GoalIndex] = Generation;
+	Open.HeapPush(FGASearchNode(GoalIndex, 0.0f), Predicate);
+
+	while (Open.Num() > 0)
+	{
+		FGASearchNode Node;
+		Open.HeapPop(Node, Predicate, false);
+
+		if (IsClosed(Node.CellIndex))
+		{
+			continue;
+		}
+		ClosedStamp[Node.CellIndex] = Generation;
+		ExpandedCount++;
+
+		const int32 X = Node.CellIndex % XCount;
+		const int32 Y = Node.CellIndex / XCount;
+
+		// Settled, so our parent is final: step towards it
+		const int32 ParentIndex = Parent[Node.CellIndex];
+		Directions[Node.CellIndex] = (ParentIndex == INDEX_NONE) ? FGAFlowField::AtGoal :
+			FGAFlowField::GetDirectionIndex((ParentIndex % XCount) - X, (ParentIndex / XCount) - Y);
+
+		for (int32 Direction = 0; Direction < 8; Direction++)
+		{
+			const int32 DX = NeighborDX[Direction];
+			const int32 DY = NeighborDY[Direction];
+			const int32 NX = X + DX;
+			const int32 NY = Y + DY;
+
+			if (!IsTraversable(Grid, NX, NY))
+			{
+				continue;
+			}
+
+			float StepCost = StraightCost;
+			if (DX != 0 && DY != 0)
+			{
+				if (!IsTraversable(Grid, NX, Y) || !IsTraversable(Grid, X, NY))
+				{
+					continue;
+				}
+				StepCost = DiagonalCost;
+			}
+
+			const int32 NeighborIndex = NY * XCount + NX;
+			const float NewCost = Node.Cost + StepCost;
+			if (!IsOpened(NeighborIndex) || (!IsClosed(NeighborIndex) && (NewCost < Cost[NeighborIndex])))
+			{
+				OpenStamp[NeighborIndex] = Generation;
+				Cost[NeighborIndex] = NewCost;
+				Parent[NeighborIndex] = Node.CellIndex;
+				Open.HeapPush(FGASearchNode(NeighborIndex, NewCost), Predicate);
+			}
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_GACellsExpanded, ExpandedCount);
+	return true;
+}
+
+
+bool FGAGridSearch::AStar(const AGAGridActor* Grid, const FCellRef& StartCell, const FCellRef& GoalCell, TArray<FCellRef>& PathOut, const FGridBox* Bounds)
+{
+	PathOut.Reset();
+
+	// Different regions means no path, so don't bother searching everything we can reach to find that out
+	if (!Grid || !Grid->AreConnected(StartCell, GoalCell))
+	{
+		return false;
+	}
+
+	check(Grid->Data.Num() == Grid->XCount * Grid->YCount);
+
+	if (!BeginAStar(Grid->GetTraversableBits(), Grid->GetClearanceField(), StartCell, GoalCell, Bounds))
+	{
+		return false;
+	}
+
+	return StepAStar(MAX_int32, PathOut) == EGASearchStatus::Found;
+}
+
+
+bool FGAGridSearch::AStar(const FGAGridSnapshot& Snapshot, const FCellRef& StartCell, const FCellRef& GoalCell, TArray<FCellRef>& PathOut, const FGridBox* Bounds)
+{
+	PathOut.Reset();
+
+	if (!BeginAStar(Snapshot, StartCell, GoalCell, Bounds))
+	{
+		return false;
+	}
+
+	return StepAStar(MAX_int32, PathOut) == EGASearchStatus::Found;
+}
+
+
+bool FGAGridSearch::BeginAStar(const AGAGridActor* Grid, const FCellRef& StartCell, const FCellRef& GoalCell, const FGridBox* Bounds)
+{
+	return Grid && Grid->AreConnected(StartCell, GoalCell) && BeginAStar(Grid->GetTraversableBits(), Grid->GetClearanceField(), StartCell, GoalCell, Bounds);
+}
+
+
+bool FGAGridSearch::BeginAStar(const FGAGridSnapshot& Snapshot, const FCellRef& StartCell, const FCellRef& GoalCell, const FGridBox* Bounds)
+{
+	return BeginAStar(Snapshot.Traversable, Snapshot.Clearance, StartCell, GoalCell, Bounds);
+}
+
+
+bool FGAGridSearch::BeginAStar(const FGAGridBitPlane& Traversable, const TArray<uint8>& Clearance, const FCellRef& StartCell, const FCellRef& GoalCell, const FGridBox* Bounds)
+{
+	const int32 GridXCount = Traversable.GetXCount();
+	const int32 GridYCount = Traversable.GetYCount();
+
+	const FGAPassability Passability(Traversable, Clearance, MinClearance, StartCell.Y * GridXCount + StartCell.X, GoalCell.Y * GridXCount + GoalCell.X);
+	if (!IsTraversable(Passability, StartCell.X, StartCell.Y) || !IsTraversable(Passability, GoalCell.X, GoalCell.Y))
+	{
+		return false;
+	}
+
+	// No bounds means the whole grid
+	const FGridBox SearchBounds = Bounds ? *Bounds : FGridBox(0, GridXCount - 1, 0, GridYCount - 1);
+	if (!SearchBounds.IsValidCell(StartCell) || !SearchBounds.IsValidCell(GoalCell))
+	{
+		return false;
+	}
+
+	BeginQuery(GridXCount, GridYCount);
+
+	SliceTraversable = &Traversable;
+	SliceClearance = &Clearance;
+	SliceGoal = GoalCell;
+	SliceGoalIndex = GoalCell.Y * XCount + GoalCell.X;
+	SliceStartIndex = StartCell.Y * XCount + StartCell.X;
+	SliceBounds = SearchBounds;
+
+	// Note: for A* the heap is ordered on F = G + H, while the Cost array holds G
+	const FGASearchNodePredicate Predicate;
+
+	const int32 StartIndex = StartCell.Y * XCount + StartCell.X;
+	Cost[StartIndex] = 0.0f;
+	Parent[StartIndex] = INDEX_NONE;
+	OpenStamp[StartIndex] = Generation;
+	Open.HeapPush(FGASearchNode(StartIndex, OctileDistance(GoalCell.X - StartCell.X, GoalCell.Y - StartCell.Y)), Predicate);
+
+	return true;
+}
+
+
+EGASearchStatus FGAGridSearch::StepAStar(int32 MaxExpansions, TArray<FCellRef>& PathOut)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GAAStar);
+
+	if (!SliceTraversable || !SliceClearance || (SliceGoalIndex == INDEX_NONE))
+	{
+		// Nothing in progress, or another query has since reused our arrays
+		return EGASearchStatus::Failed;
+	}
+
+	const FGAPassability Passability(*SliceTraversable, *SliceClearance, MinClearance, SliceStartIndex, SliceGoalIndex);
+
+	const FGASearchNodePredicate Predicate;
+	const FGridBox& SearchBounds = SliceBounds;
+	const FCellRef GoalCell = SliceGoal;
+	const int32 GoalIndex = SliceGoalIndex;
+	const int32 StartExpandedCount = ExpandedCount;
+
+	while (Open.Num() > 0)
+	{
+		if (ExpandedCount - StartExpandedCount >= MaxExpansions)
+		{
+			INC_DWORD_STAT_BY(STAT_GACellsExpanded, ExpandedCount - StartExpandedCount);
+			return EGASearchStatus::InProgress;
+		}
+
+		FGASearchNode Node;
+		Open.HeapPop(Node, Predicate, false);
+
+		if (IsClosed(Node.CellIndex))
+		{
+			continue;
+		}
+		ClosedStamp[Node.CellIndex] = Generation;
+		ExpandedCount++;
+
+		if (Node.CellIndex == GoalIndex)
+		{
+			BuildPath(GoalIndex, PathOut);
+			INC_DWORD_STAT_BY(STAT_GACellsExpanded, ExpandedCount - StartExpandedCount);
+			SliceGoalIndex = INDEX_NONE;
+			return EGASearchStatus::Found;
+		}
+
+		const int32 X = Node.CellIndex % XCount;
+		const int32 Y = Node.CellIndex / XCount;
+		const float NodeCost = Cost[Node.CellIndex];
+
+		for (int32 Direction = 0; Direction < 8; Direction++)
+		{
+			const int32 DX = NeighborDX[Direction];
+			const int32 DY = NeighborDY[Direction];
+			const int32 NX = X + DX;
+			const int32 NY = Y + DY;
+
+			if ((NX < SearchBounds.MinX) || (NX > SearchBounds.MaxX) || (NY < SearchBounds.MinY) || (NY > SearchBounds.MaxY))
+			{
+				continue;
+			}
+			if (!IsTraversable(Passability, NX, NY))
+			{
+				continue;
+			}
+
+			float StepCost = StraightCost;
+			if (DX != 0 && DY != 0)
+			{
+				if (!IsTraversable(Passability, NX, Y) || !IsTraversable(Passability, X, NY))
+				{
+					continue;
+				}
+				StepCost = DiagonalCost;
+			}
+
+			const int32 NeighborIndex = NY * XCount + NX;
+			const float NewCost = NodeCost + StepCost;
+			if (!IsOpened(NeighborIndex) || (!IsClosed(NeighborIndex) && (NewCost < Cost[NeighborIndex])))
+			{
+				OpenStamp[NeighborIndex] = Generation;
+				Cost[NeighborIndex] = NewCost;
+				Parent[NeighborIndex] = Node.CellIndex;
+
+				float Heuristic = OctileDistance(GoalCell.X - NX, GoalCell.Y - NY);
+				Open.HeapPush(FGASearchNode(NeighborIndex, NewCost + Heuristic), Predicate);
+			}
+		}
+	}
+
+	// Open list ran dry, the goal is unreachable
+	INC_DWORD_STAT_BY(STAT_GACellsExpanded, ExpandedCount - StartExpandedCount);
+	SliceGoalIndex = INDEX_NONE;
+	return EGASearchStatus::Failed;
+}
+
+
+bool FGAGridSearch::JumpPointSearch(const AGAGridActor* Grid, const FCellRef& StartCell, const FCellRef& GoalCell, TArray<FCellRef>& PathOut)
+{
+	if (!Grid || !Grid->GetJumpPointTable().IsValidFor(Grid->XCount, Grid->YCount) || (MinClearance > 1))
+	{
+		// No table (or a stale one), so do it the slow way. Same if we need clearance, since the jumps don't know about it.
+		return AStar(Grid, StartCell, GoalCell, PathOut);
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_GAJumpPointSearch);
+
+	PathOut.Reset();
+
+	if (!Grid->AreConnected(StartCell, GoalCell))
+	{
+		return false;
+	}
+
+	const FGAJumpPointTable& Table = Grid->GetJumpPointTable();
+
+	BeginQuery(Grid);
+
+	const FGASearchNodePredicate Predicate;
+
+	const int32 StartIndex = Grid->CellRefToIndex(StartCell);
+	const int32 GoalIndex = Grid->CellRefToIndex(GoalCell);
+
+	Cost[StartIndex] = 0.0f;
+	Parent[StartIndex] = INDEX_NONE;
+	ArrivalDirection[StartIndex] = 0xFF;
+	OpenStamp[StartIndex] = Generation;
+	Open.HeapPush(FGASearchNode(StartIndex, OctileDistance(GoalCell.X - StartCell.X, GoalCell.Y - StartCell.Y)), Predicate);
+
+	while (Open.Num() > 0)
+	{
+		FGASearchNode Node;
+		Open.HeapPop(Node, Predicate, false);
+
+		if (IsClosed(Node.CellIndex))
+		{
+			continue;
+		}
+		ClosedStamp[Node.CellIndex] = Generation;
+		ExpandedCount++;
+
+		if (Node.CellIndex == GoalIndex)
+		{
+			// The parent links only connect jump points, so fill in the cells in between
+			BuildPath(GoalIndex, PathOut);
+			FillJumps(PathOut);
+			INC_DWORD_STAT_BY(STAT_GACellsExpanded, ExpandedCount);
+			return true;
+		}
+
+		const int32 X = Node.CellIndex % XCount;
+		const int32 Y = Node.CellIndex / XCount;
+		const float NodeCost = Cost[Node.CellIndex];
+		const int32 GoalDX = GoalCell.X - X;
+		const int32 GoalDY = GoalCell.Y - Y;
+		const uint8 DirectionMask = GetJumpDirectionMask(ArrivalDirection[Node.CellIndex]);
+
+		for (int32 Direction = 0; Direction < 8; Direction++)
+		{
+			if ((DirectionMask & (1 << Direction)) == 0)
+			{
+				continue;
+			}
+
+			const int32 DX = NeighborDX[Direction];
+			const int32 DY = NeighborDY[Direction];
+			const int32 Distance = Table.GetDistance(Node.CellIndex, Direction);
+			const int32 FreeDistance = FMath::Abs(Distance);
+
+			int32 JumpSteps = 0;
+
+			if (!FGAJumpPointTable::IsDiagonal(Direction))
+			{
+				// Is the goal straight ahead of us, and closer than the next wall / jump point?
+				const int32 GoalAlong = GoalDX * DX + GoalDY * DY;
+				const bool bGoalOnLine = (DX != 0) ? (GoalDY == 0) : (GoalDX == 0);
+				if (bGoalOnLine && (GoalAlong > 0) && (GoalAlong <= FreeDistance))
+				{
+					JumpSteps = GoalAlong;
+				}
+				else if (Distance > 0)
+				{
+					JumpSteps = Distance;
+				}
+			}
+			else
+			{
+				// Is the goal in this quadrant? If we can get level with it (in either row or column) before running
+				// into anything, then that spot is a "target jump point" from which a straight jump reaches the goal
+				if ((FMath::Sign(GoalDX) == DX) && (FMath::Sign(GoalDY) == DY))
+				{
+					const int32 MinDiff = FMath::Min(FMath::Abs(GoalDX), FMath::Abs(GoalDY));
+					if (MinDiff <= FreeDistance)
+					{
+						JumpSteps = MinDiff;
+					}
+				}
+				if ((JumpSteps == 0) && (Distance > 0))
+				{
+					JumpSteps = Distance;
+				}
+			}
+
+			if (JumpSteps == 0)
+			{
+				continue;
+			}
+
+			const int32 NX = X + DX * JumpSteps;
+			const int32 NY = Y + DY * JumpSteps;
+			const int32 NeighborIndex = NY * XCount + NX;
+			const float NewCost = NodeCost + float(JumpSteps) * (FGAJumpPointTable::IsDiagonal(Direction) ? DiagonalCost : StraightCost);
+
+			if (!IsOpened(NeighborIndex) || (!IsClosed(NeighborIndex) && (NewCost < Cost[NeighborIndex])))
+			{
+				OpenStamp[NeighborIndex] = Generation;
+				Cost[NeighborIndex] = NewCost;
+				Parent[NeighborIndex] = Node.CellIndex;
+				ArrivalDirection[NeighborIndex] = uint8(Direction);
+
+				float Heuristic = OctileDistance(GoalCell.X - NX, GoalCell.Y - NY);
+				Open.HeapPush(FGASearchNode(NeighborIndex, NewCost + Heuristic), Predicate);
+			}
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_GACellsExpanded, ExpandedCount);
+	return false;
+}
+
+
+bool FGAGridSearch::HierarchicalSearch(const AGAGridActor* Grid, const FCellRef& StartCell, const FCellRef& GoalCell, TArray<FCellRef>& PathOut)
+{
+	// The cluster graph is built for plain traversability, so clearance queries go the slow way too
+	if (!Grid || !Grid->GetHierarchicalGraph().IsValidFor(Grid->XCount, Grid->YCount) || (MinClearance > 1))
+	{
+		return AStar(Grid, StartCell, GoalCell, PathOut);
+	}
+
+	SCOPE_CYCLE_COUNTER(STAT_GAHierarchicalSearch);
+
+	PathOut.Reset();
+
+	if (!Grid->AreConnected(StartCell, GoalCell))
+	{
+		return false;
+	}
+
+	const FGAHierarchicalGraph& Graph = Grid->GetHierarchicalGraph();
+	const int32 StartCluster = Graph.GetClusterIndex(StartCell.X, StartCell.Y);
+	const int32 GoalCluster = Graph.GetClusterIndex(GoalCell.X, GoalCell.Y);
+
+	// Short hop inside one cluster? Just search it directly.
+	if (StartCluster == GoalCluster)
+	{
+		const FGridBox ClusterBounds = Graph.GetClusterBounds(StartCluster);
+		if (AStar(Grid, StartCell, GoalCell, PathOut, &ClusterBounds))
+		{
+			return true;
+		}
+		// Otherwise the way there must leave the cluster, so carry on with the abstract search
+	}
+
+	// Hook the start and goal up to the nodes of their clusters
+	TArray<float> StartCosts;
+	TArray<float> GoalCosts;
+	Graph.GetCostsToNodes(Grid, StartCell.X, StartCell.Y, StartCosts);
+	Graph.GetCostsToNodes(Grid, GoalCell.X, GoalCell.Y, GoalCosts);
+
+	// Abstract A*. Abstract nodes are identified by their cell index, so we can use the same per-cell arrays as the other searches.
+	BeginQuery(Grid);
+
+	const FGASearchNodePredicate Predicate;
+	const int32 StartIndex = Grid->CellRefToIndex(StartCell);
+	const int32 GoalIndex = Grid->CellRefToIndex(GoalCell);
+
+	auto Relax = [&](int32 FromIndex, int32 ToIndex, float NewCost)
+	{
+		if (!IsOpened(ToIndex) || (!IsClosed(ToIndex) && (NewCost < Cost[ToIndex])))
+		{
+			OpenStamp[ToIndex] = Generation;
+			Cost[ToIndex] = NewCost;
+			Parent[ToIndex] = FromIndex;
+
+			float Heuristic = OctileDistance(GoalCell.X - ToIndex % XCount, GoalCell.Y - ToIndex / XCount);
+			Open.HeapPush(FGASearchNode(ToIndex, NewCost + Heuristic), Predicate);
+		}
+	};
+
+	Cost[StartIndex] = 0.0f;
+	Parent[StartIndex] = INDEX_NONE;
+	OpenStamp[StartIndex] = Generation;
+	Open.HeapPush(FGASearchNode(StartIndex, OctileDistance(GoalCell.X - StartCell.X, GoalCell.Y - StartCell.Y)), Predicate);
+
+	bool bFound = false;
+
+	while (Open.Num() > 0)
+	{
+		FGASearchNode Node;
+		Open.HeapPop(Node, Predicate, false);
+
+		if (IsClosed(Node.CellIndex))
+		{
+			continue;
+		}
+		ClosedStamp[Node.CellIndex] = Generation;
+		ExpandedCount++;
+
+		if (Node.CellIndex == GoalIndex)
+		{
+			bFound = true;
+			break;
+		}
+
+		const float NodeCost = Cost[Node.CellIndex];
+		const int32 ClusterIndex = Graph.GetClusterIndex(Node.CellIndex % XCount, Node.CellIndex / XCount);
+		const FGAHierarchyCluster& Cluster = Graph.GetCluster(ClusterIndex);
+
+		if (Node.CellIndex == StartIndex)
+		{
+			for (int32 Other = 0; Other < Cluster.NodeCells.Num(); Other++)
+			{
+				if (StartCosts[Other] < FLT_MAX)
+				{
+					Relax(Node.CellIndex, Cluster.NodeCells[Other], NodeCost + StartCosts[Other]);
+				}
+			}
+		}
+
+		const int32 LocalNode = Graph.FindNode(ClusterIndex, Node.CellIndex);
+		if (LocalNode == INDEX_NONE)
+		{
+			continue;
+		}
+
+		const int32 NodeCount = Cluster.NodeCells.Num();
+		for (int32 Other = 0; Other < NodeCount; Other++)
+		{
+			const float EdgeCost = Cluster.IntraCosts[LocalNode * NodeCount + Other];
+			if ((Other != LocalNode) && (EdgeCost < FLT_MAX))
+			{
+				Relax(Node.CellIndex, Cluster.NodeCells[Other], NodeCost + EdgeCost);
+			}
+		}
+
+		for (const FIntPoint& Edge : Cluster.InterEdges)
+		{
+			if (Edge.X == LocalNode)
+			{
+				Relax(Node.CellIndex, Edge.Y, NodeCost + StraightCost);
+			}
+		}
+
+		if ((ClusterIndex == GoalCluster) && (GoalCosts[LocalNode] < FLT_MAX))
+		{
+			Relax(Node.CellIndex, GoalIndex, NodeCost + GoalCosts[LocalNode]);
+		}
+	}
+
+	INC_DWORD_STAT_BY(STAT_GACellsExpanded, ExpandedCount);
+
+	if (!bFound)
+	{
+		return false;
+	}
+
+	// Refine. Consecutive abstract nodes are either in the same cluster (search just that cluster),
+	// or on either side of an entrance (a single step).
+	TArray<FCellRef> AbstractPath;
+	BuildPath(GoalIndex, AbstractPath);
+
+	TArray<FCellRef> Segment;
+	PathOut.Add(AbstractPath[0]);
+
+	for (int32 Index = 1; Index < AbstractPath.Num(); Index++)
+	{
+		const FCellRef& From = AbstractPath[Index - 1];
+		const FCellRef& To = AbstractPath[Index];
+		const int32 FromCluster = Graph.GetClusterIndex(From.X, From.Y);
+
+		if (FromCluster != Graph.GetClusterIndex(To.X, To.Y))
+		{
+			PathOut.Add(To);
+		}
+		else if (From != To)
+		{
+			const FGridBox ClusterBounds = Graph.GetClusterBounds(FromCluster);
+			if (!AStar(Grid, From, To, Segment, &ClusterBounds))
+			{
+				// The graph is out of date with respect to the grid
+				PathOut.Reset();
+				return false;
+			}
+			PathOut.Append(Segment.GetData() + 1, Segment.Num() - 1);
+		}
+	}
+
+	return true;
+}
+
+
+void FGAGridSearch::FillJumps(TArray<FCellRef>& Path)
+{
+	if (Path.Num() < 2)
+	{
+		return;
+	}
+
+	// Every jump is a straight or diagonal line, so just step along each one
+	TArray<FCellRef> JumpPoints = MoveTemp(Path);
+	Path.Reset();
+	Path.Add(JumpPoints[0]);
+
+	for (int32 Index = 1; Index < JumpPoints.Num(); Index++)
+	{
+		const FCellRef& From = JumpPoints[Index - 1];
+		const FCellRef& To = JumpPoints[Index];
+		const int32 DX = FMath::Sign(To.X - From.X);
+		const int32 DY = FMath::Sign(To.Y - From.Y);
+
+		FCellRef Cell = From;
+		while (Cell != To)
+		{
+			Cell.X += DX;
+			Cell.Y += DY;
+			Path.Add(Cell);
+		}
+	}
+}
+
+
+void FGAGridSearch::RemoveStraightRuns(TArray<FCellRef>& Path)
+{
+	if (Path.Num() < 3)
+	{
+		return;
+	}
+
+	// Compact in place, keeping every cell where the step direction changes
+	int32 WriteIndex = 1;
+	for (int32 Index = 1; Index < Path.Num() - 1; Index++)
+	{
+		const FCellRef& Prev = Path[Index - 1];
+		const FCellRef& Cell = Path[Index];
+		const FCellRef& Next = Path[Index + 1];
+		if ((Cell.X - Prev.X != Next.X - Cell.X) || (Cell.Y - Prev.Y != Next.Y - Cell.Y))
+		{
+			Path[WriteIndex++] = Cell;
+		}
+	}
+	Path[WriteIndex++] = Path.Last();
+	Path.SetNum(WriteIndex, false);
+}
+
+
+void FGAGridSearch::StringPull(const AGAGridActor* Grid, uint8 MinClearanceIn, TArray<FCellRef>& Path)
+{
+	RemoveStraightRuns(Path);
+	if ((MinClearanceIn > 1) || (Path.Num() < 3))
+	{
+		return;
+	}
+
+	// Greedy: keep going until the next turning point drops out of sight of the last corner, and make the one
+	// before it a corner. Only the turning points are candidates, which is what keeps the line tests down.
+	int32 WriteIndex = 1;
+	int32 Anchor = 0;
+	for (int32 Index = 2; Index < Path.Num(); Index++)
+	{
+		if (!Grid->HasCellLineOfSight(Path[Anchor], Path[Index]))
+		{
+			Anchor = Index - 1;
+			Path[WriteIndex++] = Path[Anchor];
+		}
+	}
+	Path[WriteIndex++] = Path.Last();
+	Path.SetNum(WriteIndex, false);
+}
+
+
+void FGAGridSearch::BuildPath(int32 CellIndex, TArray<FCellRef>& PathOut) const
+{
+	PathOut.Reset();
+	while (CellIndex != INDEX_NONE)
+	{
+		PathOut.Add(FCellRef(CellIndex % XCount, CellIndex / XCount));
+		CellIndex = Parent[CellIndex];
+	}
+	Algo::Reverse(PathOut);
+}
+
+
+FCellRef FGAGridSearch::GetParent(const FCellRef& Cell) const
+{
+	if ((Cell.X >= 0) && (Cell.Y >= 0) && (Cell.X < XCount) && (Cell.Y < YCount))
+	{
+		int32 CellIndex = Cell.Y * XCount + Cell.X;
+		int32 ParentIndex = IsOpened(CellIndex) ? Parent[CellIndex] : INDEX_NONE;
+		if (ParentIndex != INDEX_NONE)
+		{
+			return FCellRef(ParentIndex % XCount, ParentIndex / XCount);
+		}
+	}
+	return FCellRef::Invalid;
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameAI/Grid/GAGridActor.h"
+#include "GameAI/Grid/GAGridMap.h"
+
+struct FGAFlowField;
+
+
+// A single entry in the open list. Note that we use lazy deletion: when a cell's cost improves we
+// just push it again, and any entry whose Cost no longer matches the cell's best cost is skipped when popped.
+
+struct FGASearchNode
+{
+	FGASearchNode() : CellIndex(INDEX_NONE), Cost(0.0f) {}
+	FGASearchNode(int32 CellIndexIn, float CostIn) : CellIndex(CellIndexIn), Cost(CostIn) {}
+
+	int32 CellIndex;
+	float Cost;
+};
+
+// Where a sliced search (see FGAGridSearch::BeginAStar) has got to
+enum class EGASearchStatus : uint8
+{
+	InProgress,
+	Found,
+	Failed,
+};
+
+struct FGASearchNodePredicate
+{
+	FORCEINLINE bool operator()(const FGASearchNode& A, const FGASearchNode& B) const
+	{
+		return A.Cost < B.Cost;
+	}
+};
+
+
+// Reusable search engine over the traversability data of an AGAGridActor
+// All the per-cell bookkeeping lives in flat arrays indexed by AGAGridActor::CellRefToIndex, rather than
+// in TMaps keyed on FCellRef, and the open list is a binary heap. Hang on to one of these (the path component does)
+// so the arrays are only reallocated when the grid changes size.
+//
+// The per-cell arrays are never cleared between queries. Instead each query bumps a generation counter, and a cell's
+// Cost/Parent are only meaningful if its OpenStamp matches the current generation. Same deal for ClosedStamp.
+//
+// Movement is 8-connected with octile costs: 1 for a straight step, sqrt(2) for a diagonal one.
+// Diagonal steps are not allowed to cut corners, i.e. both of the orthogonal cells they pass between must be traversable.
+
+class FGAGridSearch
+{
+public:
+	static constexpr float StraightCost = 1.0f;
+	static constexpr float DiagonalCost = UE_SQRT_2;
+
+	// Run a full Dijkstra from StartCell, restricted to the bounds of DistanceMapOut.
+	// Reached cells get their path distance (in cells), unreached cells are left untouched -- so initialize the map to FLT_MAX.
+	// Returns false if the start cell is not traversable or not inside the map.
+	// If ReachableOut is given, it gets every reached cell in the order they were settled (so nearest first), as an
+	// index into DistanceMapOut.Data plus the distance. Usually that's a small fraction of the map, so iterate this
+	// rather than the whole map.
+	bool Dijkstra(const AGAGridActor* Grid, const FCellRef& StartCell, FGAGridMap& DistanceMapOut, TArray<FGASparseCell>* ReachableOut = nullptr);
+
+	// Build a flow field towards GoalCell over the whole grid
+	// This is a Dijkstra out from the goal. Movement costs are symmetric, so the cell each cell was reached from is
+	// also its best next step towards the goal, and that's the direction we store. Returns false if the goal isn't traversable.
+	bool BuildFlowField(const AGAGridActor* Grid, const FCellRef& GoalCell, FGAFlowField& FieldOut);
+
+	// Point-to-point A* from StartCell to GoalCell, using the octile distance as the heuristic.
+	// On success PathOut holds the cells of the path, starting with StartCell and ending with GoalCell.
+	// If Bounds is given, the search won't leave that box.
+	// Fails straight away if the two cells are in different regions (see AGAGridActor::AreConnected).
+	bool AStar(const AGAGridActor* Grid, const FCellRef& StartCell, const FCellRef& GoalCell, TArray<FCellRef>& PathOut, const FGridBox* Bounds = nullptr);
+
+	// The same, but against a snapshot rather than the grid actor itself
+	// Doesn't touch any UObjects, so it's safe to run on a worker thread (see AGAGridActor::GetSnapshot).
+	bool AStar(const FGAGridSnapshot& Snapshot, const FCellRef& StartCell, const FCellRef& GoalCell, TArray<FCellRef>& PathOut, const FGridBox* Bounds = nullptr);
+
+	// The same A*, but sliced so a long search can be spread over several frames
+	// BeginAStar sets the search up (false if it can't possibly succeed), then call StepAStar until it stops returning
+	// InProgress. Each call settles at most MaxExpansions cells; PathOut is filled in once it returns Found.
+	// Any other query on this FGAGridSearch in between abandons the sliced one (StepAStar then returns Failed).
+	// Note the grid must not change under a sliced search -- restart it if the grid version moves on. Likewise a snapshot
+	// has to outlive the search.
+	bool BeginAStar(const AGAGridActor* Grid, const FCellRef& StartCell, const FCellRef& GoalCell, const FGridBox* Bounds = nullptr);
+	bool BeginAStar(const FGAGridSnapshot& Snapshot, const FCellRef& StartCell, const FCellRef& GoalCell, const FGridBox* Bounds = nullptr);
+	EGASearchStatus StepAStar(int32 MaxExpansions, TArray<FCellRef>& PathOut);
+
+	// Same as AStar, but using the grid's JPS+ jump table to skip over the open areas
+	// Expands far fewer cells on open maps. Falls back to plain AStar if the grid has no (up to date) jump table,
+	// or if there's a minimum clearance.
+	bool JumpPointSearch(const AGAGridActor* Grid, const FCellRef& StartCell, const FCellRef& GoalCell, TArray<FCellRef>& PathOut);
+
+	// HPA*: search the grid's abstract cluster graph, then refine the abstract path cluster by cluster
+	// Much cheaper than AStar for long queries on big grids, at the price of paths that are slightly longer than optimal.
+	// Falls back to plain AStar if the grid has no (up to date) hierarchy, or if there's a minimum clearance.
+	bool HierarchicalSearch(const AGAGridActor* Grid, const FCellRef& StartCell, const FCellRef& GoalCell, TArray<FCellRef>& PathOut);
+
+	// Only let Dijkstra and A* use cells with at least this clearance (see AGAGridActor::GetClearance), so bigger agents
+	// don't plan through gaps they won't fit. 0 or 1 means any traversable cell. Sticks until changed.
+	// The start and goal cells are exempt: they only need to be traversable, so an agent up against a wall can still plan.
+	// Flow fields ignore this, since they're shared by agents of every size.
+	void SetMinClearance(uint8 MinClearanceIn) { MinClearance = MinClearanceIn; }
+	uint8 GetMinClearance() const { return MinClearance; }
+
+	// Octile distance between two cells -- the exact path length on an empty grid
+	static float OctileDistance(int32 DX, int32 DY)
+	{
+		DX = FMath::Abs(DX);
+		DY = FMath::Abs(DY);
+		return StraightCost * float(FMath::Max(DX, DY)) + (DiagonalCost - StraightCost) * float(FMath::Min(DX, DY));
+	}
+
+	// After a search, the cell we came from on the way to the given cell (FCellRef::Invalid for the start, or unreached cells)
+	FCellRef GetParent(const FCellRef& Cell) const;
+
+	// Expand a list of jump points (each pair joined by a straight or diagonal line) into the full list of cells
+	static void FillJumps(TArray<FCellRef>& Path);
+
+	// The reverse: cut a path down to just the cells where it changes direction (plus its two ends)
+	static void RemoveStraightRuns(TArray<FCellRef>& Path);
+
+	// String pulling: cut a path down to the corners an any-angle path would turn at
+	// From each corner we skip ahead to the furthest turning point of the path that's still in line of sight
+	// (AGAGridActor::HasCellLineOfSight). The result is no longer made of straight or diagonal runs, so it can't go
+	// back through FillJumps. Line of sight knows nothing about clearance, so with a MinClearance over 1 this only
+	// removes the straight runs.
+	static void StringPull(const AGAGridActor* Grid, uint8 MinClearanceIn, TArray<FCellRef>& Path);
+
+	// Number of cells settled by the last search. Handy for profiling.
+	int32 GetExpandedCount() const { return ExpandedCount; }
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return Cost.GetAllocatedSize() + Parent.GetAllocatedSize() + ArrivalDirection.GetAllocatedSize() +
+			OpenStamp.GetAllocatedSize() + ClosedStamp.GetAllocatedSize() + Open.GetAllocatedSize();
+	}
+
+private:
+	// Start a new query. Only touches the per-cell arrays if the grid changed size (or the generation wrapped).
+	void BeginQuery(int32 XCountIn, int32 YCountIn);
+	void BeginQuery(const AGAGridActor* Grid) { BeginQuery(Grid->XCount, Grid->YCount); }
+
+	bool BeginAStar(const FGAGridBitPlane& Traversable, const TArray<uint8>& Clearance, const FCellRef& StartCell, const FCellRef& GoalCell, const FGridBox* Bounds);
+
+	FORCEINLINE bool IsOpened(int32 CellIndex) const { return OpenStamp[CellIndex] == Generation; }
+	FORCEINLINE bool IsClosed(int32 CellIndex) const { return ClosedStamp[CellIndex] == Generation; }
+
+	// Walk the parent links back from CellIndex
+	void BuildPath(int32 CellIndex, TArray<FCellRef>& PathOut) const;
+
+	int32 XCount = 0;
+	int32 YCount = 0;
+	uint32 Generation = 0;
+
+	TArray<float> Cost;
+	TArray<int32> Parent;
+	TArray<uint8> ArrivalDirection;		// only used by jump point search
+	TArray<uint32> OpenStamp;
+	TArray<uint32> ClosedStamp;
+	TArray<FGASearchNode> Open;
+
+	int32 ExpandedCount = 0;
+
+	uint8 MinClearance = 0;
+
+	// Sliced A* state, SliceGoalIndex is INDEX_NONE when there's nothing in progress
+	const FGAGridBitPlane* SliceTraversable = nullptr;
+	const TArray<uint8>* SliceClearance = nullptr;
+	FCellRef SliceGoal;
+	int32 SliceGoalIndex = INDEX_NONE;
+	int32 SliceStartIndex = INDEX_NONE;
+	FGridBox SliceBounds;
+};
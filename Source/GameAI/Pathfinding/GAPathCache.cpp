@@ -0,0 +1,251 @@
+#include "GAPathCache.h"
+#include "GAGridSearch.h"
+#include "GameAI/GameAI.h"
+#include "Algo/Reverse.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("GA Path Cache Entries"), STAT_GAPathCacheEntries, STATGROUP_GameAI);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("GA Path Cache Hits"), STAT_GAPathCacheHits, STATGROUP_GameAI);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("GA Path Cache Misses"), STAT_GAPathCacheMisses, STATGROUP_GameAI);
+
+
+// Where Cell falls along a compact path, counting in cells from the start, or INDEX_NONE if it isn't on it
+static int32 FindOnPath(const TArray<FCellRef>& Corners, const FCellRef& Cell)
+{
+	int32 Position = 0;
+	for (int32 Index = 1; Index < Corners.Num(); Index++)
+	{
+		const FCellRef& From = Corners[Index - 1];
+		const FCellRef& To = Corners[Index];
+		const int32 DX = FMath::Sign(To.X - From.X);
+		const int32 DY = FMath::Sign(To.Y - From.Y);
+		const int32 Length = FMath::Max(FMath::Abs(To.X - From.X), FMath::Abs(To.Y - From.Y));
+
+		// Every segment is straight or diagonal, so the cell is on it iff it's a whole number of steps along
+		const int32 Step = (DX != 0) ? (Cell.X - From.X) * DX : (Cell.Y - From.Y) * DY;
+		if ((Step >= 0) && (Step <= Length) && (Cell.X == From.X + Step * DX) && (Cell.Y == From.Y + Step * DY))
+		{
+			return Position + Step;
+		}
+
+		Position += Length;
+	}
+
+	return ((Corners.Num() == 1) && (Corners[0] == Cell)) ? 0 : INDEX_NONE;
+}
+
+
+bool FGAPathCache::Find(const FCellRef& StartCell, const FCellRef& GoalCell, uint32 Options, uint32 GridVersion, TArray<FCellRef>& PathOut)
+{
+	CheckVersion(GridVersion);
+	UseCounter++;
+
+	if (FEntry* Entry = Entries.Find(FKey{ StartCell, GoalCell, Options }))
+	{
+		Entry->LastUsed = UseCounter;
+		PathOut = Entry->Corners;
+		FGAGridSearch::FillJumps(PathOut);
+
+		HitCount++;
+		INC_DWORD_STAT(STAT_GAPathCacheHits);
+		return true;
+	}
+
+	// No exact match, but maybe we're somewhere along a path we already know
+	for (TPair<FKey, FEntry>& Pair : Entries)
+	{
+		FEntry& Entry = Pair.Value;
+		if ((Entry.Options == Options) && ExtractSubPath(Entry, StartCell, GoalCell, PathOut))
+		{
+			Entry.LastUsed = UseCounter;
+
+			PartialHitCount++;
+			INC_DWORD_STAT(STAT_GAPathCacheHits);
+			return true;
+		}
+	}
+
+	MissCount++;
+	INC_DWORD_STAT(STAT_GAPathCacheMisses);
+	return false;
+}
+
+
+void FGAPathCache::Add(const TArray<FCellRef>& Path, uint32 Options, uint32 GridVersion)
+{
+	if ((Path.Num() == 0) || (MaxEntries <= 0))
+	{
+		return;
+	}
+
+	CheckVersion(GridVersion);
+	UseCounter++;
+
+	const FKey Key{ Path[0], Path.Last(), Options };
+	if (!Entries.Contains(Key) && (Entries.Num() >= MaxEntries))
+	{
+		EvictOldest();
+	}
+
+	FEntry& Entry = Entries.FindOrAdd(Key);
+	Entry.Options = Options;
+	Entry.LastUsed = UseCounter;
+
+	// Keep the ends, and any cell where the step direction changes
+	Entry.Corners.Reset();
+	Entry.Corners.Add(Path[0]);
+	for (int32 Index = 1; Index < Path.Num() - 1; Index++)
+	{
+		const FCellRef& Prev = Path[Index - 1];
+		const FCellRef& Cell = Path[Index];
+		const FCellRef& Next = Path[Index + 1];
+		if (((Cell.X - Prev.X) != (Next.X - Cell.X)) || ((Cell.Y - Prev.Y) != (Next.Y - Cell.Y)))
+		{
+			Entry.Corners.Add(Cell);
+		}
+	}
+	if (Path.Num() > 1)
+	{
+		Entry.Corners.Add(Path.Last());
+	}
+	Entry.Corners.Shrink();
+
+	SET_DWORD_STAT(STAT_GAPathCacheEntries, Entries.Num());
+}
+
+
+void FGAPathCache::Empty()
+{
+	Entries.Empty();
+	SET_DWORD_STAT(STAT_GAPathCacheEntries, 0);
+}
+
+
+void FGAPathCache::SetMaxEntries(int32 MaxEntriesIn)
+{
+	MaxEntries = FMath::Max(MaxEntriesIn, 0);
+	while (Entries.Num() > MaxEntries)
+	{
+		EvictOldest();
+	}
+}
+
+
+SIZE_T FGAPathCache::GetAllocatedSize() const
+{
+	SIZE_T Result = Entries.GetAllocatedSize();
+	for (const TPair<FKey, FEntry>& Pair : Entries)
+	{
+		Result += Pair.Value.Corners.GetAllocatedSize();
+	}
+	return Result;
+}
+
+
+float FGAPathCache::GetHitRate() const
+{
+	const uint64 Lookups = HitCount + PartialHitCount + MissCount;
+	return (Lookups > 0) ? float(double(HitCount + PartialHitCount) / double(Lookups)) : 0.0f;
+}
+
+
+void FGAPathCache::ResetCounters()
+{
+	HitCount = 0;
+	PartialHitCount = 0;
+	MissCount = 0;
+	EvictionCount = 0;
+}
+
+
+void FGAPathCache::LogStats() const
+{
+	UE_LOG(LogTemp, Log, TEXT("Path cache: %d/%d entries (%llu bytes), %llu hits, %llu partial hits, %llu misses, %llu evictions, hit rate %.1f%%"),
+		Entries.Num(), MaxEntries, uint64(GetAllocatedSize()), HitCount, PartialHitCount, MissCount, EvictionCount, GetHitRate() * 100.0f);
+}
+
+
+void FGAPathCache::CheckVersion(uint32 GridVersion)
+{
+	if (GridVersion != Version)
+	{
+		Empty();
+		Version = GridVersion;
+	}
+}
+
+
+bool FGAPathCache::ExtractSubPath(const FEntry& Entry, const FCellRef& StartCell, const FCellRef& GoalCell, TArray<FCellRef>& PathOut)
+{
+	const int32 StartPosition = FindOnPath(Entry.Corners, StartCell);
+	if (StartPosition == INDEX_NONE)
+	{
+		return false;
+	}
+	const int32 GoalPosition = FindOnPath(Entry.Corners, GoalCell);
+	if (GoalPosition == INDEX_NONE)
+	{
+		return false;
+	}
+
+	// Moves cost the same both ways, so a stretch we'd walk backwards is just as good
+	const int32 FromPosition = FMath::Min(StartPosition, GoalPosition);
+	const int32 ToPosition = FMath::Max(StartPosition, GoalPosition);
+
+	PathOut.Reset();
+	int32 Position = 0;
+	for (int32 Index = 1; (Index < Entry.Corners.Num()) && (Position <= ToPosition); Index++)
+	{
+		const FCellRef& From = Entry.Corners[Index - 1];
+		const FCellRef& To = Entry.Corners[Index];
+		const int32 DX = FMath::Sign(To.X - From.X);
+		const int32 DY = FMath::Sign(To.Y - From.Y);
+		const int32 Length = FMath::Max(FMath::Abs(To.X - From.X), FMath::Abs(To.Y - From.Y));
+
+		// The last cell of each segment is the first of the next, so only the final segment includes its end
+		const int32 LastStep = (Index == Entry.Corners.Num() - 1) ? Length : Length - 1;
+		for (int32 Step = 0; Step <= LastStep; Step++)
+		{
+			const int32 CellPosition = Position + Step;
+			if ((CellPosition >= FromPosition) && (CellPosition <= ToPosition))
+			{
+				PathOut.Add(FCellRef(From.X + Step * DX, From.Y + Step * DY));
+			}
+		}
+		Position += Length;
+	}
+
+	if (PathOut.Num() == 0)
+	{
+		// Single-cell entry
+		PathOut.Add(StartCell);
+	}
+
+	if (StartPosition > GoalPosition)
+	{
+		Algo::Reverse(PathOut);
+	}
+
+	return true;
+}
+
+
+void FGAPathCache::EvictOldest()
+{
+	const FKey* OldestKey = nullptr;
+	uint64 OldestUse = MAX_uint64;
+	for (const TPair<FKey, FEntry>& Pair : Entries)
+	{
+		if (Pair.Value.LastUsed < OldestUse)
+		{
+			OldestKey = &Pair.Key;
+			OldestUse = Pair.Value.LastUsed;
+		}
+	}
+
+	if (OldestKey)
+	{
+		const FKey Key = *OldestKey;
+		Entries.Remove(Key);
+		EvictionCount++;
+	}
+}
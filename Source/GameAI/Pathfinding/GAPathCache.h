@@ -0,0 +1,94 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameAI/Grid/GAGridActor.h"
+
+
+// A bounded cache of recent path results, shared by everyone planning on the same grid
+// Paths are keyed by start cell, goal cell, search options (e.g. the search mode) and grid version, and stored compactly
+// as just their turning points. When the grid version changes the whole cache is dropped, since any of it could be wrong.
+//
+// Besides exact hits, a query whose start and goal both lie (in that order) on a cached path with the same options
+// reuses that stretch of it: a piece of a shortest path is itself a shortest path. That covers the common case of an
+// agent partway along a route someone else (or it itself) already planned.
+//
+// Game thread only.
+
+class FGAPathCache
+{
+public:
+	explicit FGAPathCache(int32 MaxEntriesIn = 128) : MaxEntries(MaxEntriesIn) {}
+
+	// Fill PathOut (start to goal, every cell) from the cache if we can
+	bool Find(const FCellRef& StartCell, const FCellRef& GoalCell, uint32 Options, uint32 GridVersion, TArray<FCellRef>& PathOut);
+
+	// Remember a path. Path runs from its start cell to its goal cell, every cell.
+	void Add(const TArray<FCellRef>& Path, uint32 Options, uint32 GridVersion);
+
+	void Empty();
+
+	void SetMaxEntries(int32 MaxEntriesIn);
+
+	int32 Num() const { return Entries.Num(); }
+
+	SIZE_T GetAllocatedSize() const;
+
+	// Counters, for tuning MaxEntries ------------
+
+	uint64 GetHitCount() const { return HitCount; }
+	uint64 GetPartialHitCount() const { return PartialHitCount; }
+	uint64 GetMissCount() const { return MissCount; }
+	uint64 GetEvictionCount() const { return EvictionCount; }
+
+	// Fraction of lookups answered from the cache, partial hits included
+	float GetHitRate() const;
+
+	void ResetCounters();
+
+	void LogStats() const;
+
+private:
+	struct FKey
+	{
+		FCellRef StartCell;
+		FCellRef GoalCell;
+		uint32 Options = 0;
+
+		bool operator==(const FKey& Other) const
+		{
+			return (StartCell == Other.StartCell) && (GoalCell == Other.GoalCell) && (Options == Other.Options);
+		}
+
+		friend uint32 GetTypeHash(const FKey& Key)
+		{
+			return HashCombine(HashCombine(GetTypeHash(Key.StartCell), GetTypeHash(Key.GoalCell)), Key.Options);
+		}
+	};
+
+	struct FEntry
+	{
+		// Just the cells where the path changes direction, plus the two ends
+		TArray<FCellRef> Corners;
+		uint32 Options = 0;
+		uint64 LastUsed = 0;
+	};
+
+	// Drop everything if the grid has moved on since we last looked
+	void CheckVersion(uint32 GridVersion);
+
+	// Try to pull the StartCell..GoalCell stretch out of an entry
+	static bool ExtractSubPath(const FEntry& Entry, const FCellRef& StartCell, const FCellRef& GoalCell, TArray<FCellRef>& PathOut);
+
+	void EvictOldest();
+
+	TMap<FKey, FEntry> Entries;
+
+	int32 MaxEntries;
+	uint32 Version = 0;
+	uint64 UseCounter = 0;
+
+	uint64 HitCount = 0;
+	uint64 PartialHitCount = 0;
+	uint64 MissCount = 0;
+	uint64 EvictionCount = 0;
+};
@@ -1,4 +1,6 @@
 #include "GAPathComponent.h"
+#include "GAFlowFieldSubsystem.h"
+#include "GAPathRequestSubsystem.h"
 #include "GameFramework/NavMovementComponent.h"
 #include "Kismet/GameplayStatics.h"
 #include "Algo/Reverse.h"
@@ -9,7 +11,15 @@ UGAPathComponent::UGAPathComponent(const FObjectInitializer& ObjectInitializer)
 	State = GAPS_None;
 	bDestinationValid = false;
 	ArrivalDistance = 100.0f;
+	AgentRadius = 0.0f;
 	bRebuildPathRequested = false;
+	SearchMode = GAPM_AStar;
+	bUsePathScheduler = true;
+	bUseAsyncSearch = false;
+	bStringPullPaths = true;
+	StepReachedDistance = 50.0f;
+	DestinationRepairCells = 4;
+	StepCursor = 0;
 
 	// A bit of Unreal magic to make TickComponent below get called
 	PrimaryComponentTick.bCanEverTick = true;
@@ -72,14 +82,46 @@ APawn* UGAPathComponent::GetOwnerPawn()
 
 void UGAPathComponent::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
 {
+	// Results from a worker thread land here, before anything else looks at Steps
+	if (AsyncQuery.IsValid() && AsyncQuery->Task.IsCompleted())
+	{
+		ApplyAsyncPath();
+	}
+
 	// Check if a path rebuild is requested
 	if (bDestinationValid && bRebuildPathRequested)
 	{
-		RefreshPath();
+		UWorld* World = GetWorld();
+		UGAPathRequestSubsystem* Scheduler = World ? World->GetSubsystem<UGAPathRequestSubsystem>() : nullptr;
+		APawn* OwnerPawn = GetOwnerPawn();
+
+		// Flow field steps are just a lookup, an incremental replan only costs as much as what's changed, and there's
+		// no point queueing anything if we're already there
+		const bool bCanDefer = OwnerPawn && (SearchMode != GAPM_FlowField) && (SearchMode != GAPM_Incremental) &&
+			(FVector::Dist(OwnerPawn->GetActorLocation(), Destination) > ArrivalDistance);
+		if (bCanDefer && bUseAsyncSearch)
+		{
+			RequestPathAsync();
+		}
+		else if (bCanDefer && bUsePathScheduler && Scheduler)
+		{
+			// Keep following the old path (if any) until the new one arrives
+			Scheduler->RequestPath(this);
+		}
+		else
+		{
+			RefreshPath();
+		}
 		// Reset the request flag
 		bRebuildPathRequested = false;
 	}
 
+	// In flow field mode the next step comes from the field, so it's cheap enough to redo every tick
+	if ((State == EGAPathState::GAPS_Active) && (SearchMode == GAPM_FlowField))
+	{
+		State = UpdateFlowFieldStep();
+	}
+
 	// Check if the state is active
 	if (State == EGAPathState::GAPS_Active)
 	{
@@ -90,267 +132,369 @@ void UGAPathComponent::TickComponent(float DeltaTime, enum ELevelTick TickType,
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 }
 
-void UGAPathComponent::SetCameFrom(const TMap<FCellRef, FVector>& InCameFrom)
+void UGAPathComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	CachedCameFrom = InCameFrom;
-}
+	CancelAsyncPath();
+
+	UWorld* World = GetWorld();
+	if (UGAPathRequestSubsystem* Scheduler = World ? World->GetSubsystem<UGAPathRequestSubsystem>() : nullptr)
+	{
+		Scheduler->CancelPath(this);
+	}
 
+	Super::EndPlay(EndPlayReason);
+}
 
-static void CameFromToPath(const TMap<FCellRef, FVector>& CameFrom, const FVector& start, const FVector& goal, TArray<FVector>& path, const AGAGridActor* GridActor)
+EGAPathState UGAPathComponent::RefreshPath()
 {
-	path.Empty();
+	AActor* Owner = GetOwnerPawn();
+	FVector StartPoint = Owner->GetActorLocation();
+
+	check(bDestinationValid);
 
-	FVector current = goal;
-	while (current != start)
+	float DistanceToDestination = FVector::Dist(StartPoint, Destination);
+
+	if (DistanceToDestination <= ArrivalDistance)
 	{
-		path.Add(current);
-		FCellRef CurrentCell;
-		if ((GridActor->GetCellRef(current, false).IsValid()))
-		{
-			// Unable to reconstruct the path
-			return;
-		}
-		current = CameFrom[CurrentCell];
+		// Yay! We got there!
+		State = GAPS_Finished;
+	}
+	else
+	{
+		State = AStar();
 	}
 
-	// Add the start point to the path
-	path.Add(start);
-
-	// Reverse the path to have it in the correct order
-	Algo::Reverse(path);
+	return State;
 }
 
-EGAPathState UGAPathComponent::GoThere(TMap<FCellRef, FVector>& CameFrom)
+
+EGAPathState UGAPathComponent::AStar()
 {
 	const AGAGridActor* Grid = GetGridActor();
+	APawn* OwnerPawn = GetOwnerPawn();
 
-	if (!Grid)
+	if (!Grid || !OwnerPawn || !DestinationCell.IsValid())
 	{
-		// Handle the case where the grid is not available
 		return GAPS_Invalid;
 	}
 
-	FIntRect CellRect;
-	FGridBox GridBox(CellRect);
-	FGAGridMap DistanceMap(Grid, GridBox, FLT_MAX);
-	AActor* Owner = GetOwnerPawn();
-	FVector StartPoint = Owner->GetActorLocation();
-	FCellRef StartRef = GridActor->GetCellRef(StartPoint, true);
-	TArray<FVector> RawPath;
-
-	// Use Dijkstra's algorithm for pathfinding
-	if (Dijkstra(StartPoint, DistanceMap, CameFrom))
+	if (SearchMode == GAPM_FlowField)
 	{
-		// Reconstruct the path from the distance map
-		FVector CurrentDestination = GetCurrentDestination();
-		CameFromToPath(CameFrom, StartPoint, CurrentDestination, RawPath, GetGridActor());
-		FCellRef CurrentDestinationRef = GridActor->GetCellRef(CurrentDestination, true);
+		return UpdateFlowFieldStep();
+	}
 
-		// Convert the array of points to Steps array
-		Steps.SetNum(CameFrom.Num());
-		int32 i = 0;
-		for (const FVector& Point : RawPath)
-		{
-			FCellRef CellRef = GetGridActor()->GetCellRef(Point);
-			ECellData CellData = GetGridActor()->GetCellData(CellRef);
-			// Check if the cell is traversable
-			if (CellData == ECellData::CellDataTraversable)
-			{
-				Steps[i].Set(FVector2D(Point.X, Point.Y), CellRef);
-				++i;
-			}
-		}
+	FCellRef StartCell = Grid->GetCellRef(OwnerPawn->GetActorLocation(), true);
 
-		// Smooth the raw path
-		State = GAPS_Active;
+	TArray<FCellRef> PathCells;
+	if (SearchMode == GAPM_Incremental)
+	{
+		// Not worth going through the cache: the planner has to see every destination move to keep its tree up to date
+		IncrementalPlanner.FindPath(Grid, StartCell, DestinationCell, GetMinClearance(), PathCells);
+		return SetStepsFromPath(Grid, PathCells);
 	}
-	else
+
+	Search.SetMinClearance(GetMinClearance());
+	FGAPathCache* PathCache = GetPathCache();
+	if (PathCache && PathCache->Find(StartCell, DestinationCell, GetPathCacheOptions(SearchMode), Grid->GetGridVersion(), PathCells))
 	{
-		State = GAPS_Invalid;
+		return SetStepsFromPath(Grid, PathCells);
 	}
 
-	return State;
+	bool bFound = false;
+	switch (SearchMode)
+	{
+	case GAPM_JumpPoint:
+		bFound = Search.JumpPointSearch(Grid, StartCell, DestinationCell, PathCells);
+		break;
+	case GAPM_Hierarchical:
+		bFound = Search.HierarchicalSearch(Grid, StartCell, DestinationCell, PathCells);
+		break;
+	case GAPM_AStar:
+	default:
+		bFound = Search.AStar(Grid, StartCell, DestinationCell, PathCells);
+		break;
+	}
+
+	if (!bFound)
+	{
+		PathCells.Reset();
+	}
+	else if (PathCache)
+	{
+		PathCache->Add(PathCells, GetPathCacheOptions(SearchMode), Grid->GetGridVersion());
+	}
+	return SetStepsFromPath(Grid, PathCells);
 }
 
-EGAPathState UGAPathComponent::RefreshPath()
+
+EGAPathState UGAPathComponent::SetStepsFromPath(const AGAGridActor* Grid, const TArray<FCellRef>& PathCells)
 {
-	AActor* Owner = GetOwnerPawn();
-	FVector StartPoint = Owner->GetActorLocation();
+	if (PathCells.Num() == 0)
+	{
+		Steps.Reset();
+		return GAPS_Invalid;
+	}
 
-	check(bDestinationValid);
+	// Only keep the corners, so we head straight for each one rather than zig-zagging from cell to cell
+	// (Leave PathCells alone, it may be going into the path cache, which wants the full path.)
+	TArray<FCellRef> Corners = PathCells;
+	if (bStringPullPaths)
+	{
+		FGAGridSearch::StringPull(Grid, GetMinClearance(), Corners);
+	}
 
-	float DistanceToDestination = FVector::Dist(StartPoint, Destination);
+	// We skip the first cell, since that's the one we're standing in.
+	Steps.SetNum(Corners.Num() - 1);
+	for (int32 Index = 1; Index < Corners.Num(); Index++)
+	{
+		const FCellRef& CellRef = Corners[Index];
+		Steps[Index - 1].Set(FVector2D(Grid->GetCellPosition(CellRef)), CellRef);
+	}
 
-	if (DistanceToDestination <= ArrivalDistance)
+	// A fresh path, so start from the top
+	StepCursor = 0;
+	StepsGridVersion = Grid->GetGridVersion();
+
+	// A queued or async search reads the destination when it starts, so by the time it comes back the destination may
+	// have moved on. In that case, the path only goes as far as the old destination cell: don't stretch the last leg on
+	// to the new destination point (it could go straight through a wall), and plan again.
+	PlannedDestinationCell = PathCells.Last();
+	const bool bReachesDestination = (PlannedDestinationCell == DestinationCell);
+	if (!bReachesDestination)
 	{
-		// Yay! We got there!
-		State = GAPS_Finished;
+		RequestPathRebuild();
 	}
-	else
+
+	if (Steps.Num() == 0)
 	{
-		// Replan the path in the event its needed
-		if (State != GAPS_Active) // Check if not already actively following a path
-		{
-			State = GAPS_Active;
-			TArray<FVector> PathPoints;
-			TMap<FCellRef, FVector> CameFrom;
-			return GoThere(CachedCameFrom); // Call the pathfinding function and return its result
-		}
+		// Already in the last cell, so just head straight for the destination point itself
+		FPathStep& FinalStep = Steps.AddDefaulted_GetRef();
+		FinalStep.Set(bReachesDestination ? FVector2D(Destination) : FVector2D(Grid->GetCellPosition(PlannedDestinationCell)), PlannedDestinationCell);
+	}
+	else if (bReachesDestination)
+	{
+		Steps.Last().Point = FVector2D(Destination);
 	}
 
-	return State;
+	return GAPS_Active;
 }
 
 
-static void SmoothPath(const TArray<FVector>& OriginalPath, TArray<FVector>& SmoothedPath)
+EGAPathState UGAPathComponent::UpdateFlowFieldStep()
 {
-	SmoothedPath.Empty();
+	const AGAGridActor* Grid = GetGridActor();
+	APawn* OwnerPawn = GetOwnerPawn();
+	UWorld* World = GetWorld();
+	UGAFlowFieldSubsystem* FlowFields = World ? World->GetSubsystem<UGAFlowFieldSubsystem>() : nullptr;
 
-	if (OriginalPath.Num() < 2)
+	if (!Grid || !OwnerPawn || !FlowFields || !DestinationCell.IsValid())
 	{
-		// Cannot smooth a path with less than two points
-		return;
+		Steps.Reset();
+		return GAPS_Invalid;
+	}
+
+	const FVector Location = OwnerPawn->GetActorLocation();
+	if (FVector::Dist(Location, Destination) <= ArrivalDistance)
+	{
+		Steps.Reset();
+		return GAPS_Finished;
 	}
 
-	// Add the first point
-	SmoothedPath.Add(OriginalPath[0]);
+	// Check we can get there at all before (maybe) building a whole field
+	const FCellRef CurrentCell = Grid->GetCellRef(Location, true);
+	if (!Grid->AreConnected(CurrentCell, DestinationCell))
+	{
+		Steps.Reset();
+		return GAPS_Invalid;
+	}
 
-	for (int32 i = 1; i < OriginalPath.Num() - 1; ++i)
+	const FGAFlowField* Field = FlowFields->GetFlowField(Grid, DestinationCell);
+	const FCellRef NextCell = Field ? Field->GetNextCell(CurrentCell) : FCellRef::Invalid;
+	if (!NextCell.IsValid())
 	{
-		// Use linear interpolation to add intermediate points
-		FVector SmoothedPoint = FMath::Lerp(OriginalPath[i - 1], OriginalPath[i + 1], 0.5f);
-		SmoothedPath.Add(SmoothedPoint);
+		Steps.Reset();
+		return GAPS_Invalid;
 	}
 
-	// Add the last point
-	SmoothedPath.Add(OriginalPath.Last());
+	// Just the one step. In the destination cell, head for the destination point itself.
+	Steps.SetNum(1);
+	StepCursor = 0;
+	if (NextCell == CurrentCell)
+	{
+		Steps[0].Set(FVector2D(Destination), DestinationCell);
+	}
+	else
+	{
+		Steps[0].Set(FVector2D(Grid->GetCellPosition(NextCell)), NextCell);
+	}
+
+	return GAPS_Active;
 }
 
-static bool IsCellValid(const AGAGridActor* GridActor, const FCellRef& Cell)
+
+void UGAPathComponent::CompleteScheduledPath(bool bFound, const TArray<FCellRef>& PathCells)
 {
-	if (!GridActor)
+	const AGAGridActor* Grid = GetGridActor();
+	if (bFound && Grid)
 	{
-		// Handle the case where the grid actor is not available
-		return false;
+		State = SetStepsFromPath(Grid, PathCells);
+	}
+	else
+	{
+		Steps.Reset();
+		State = GAPS_Invalid;
 	}
 
-	// Check if the cell is within the grid bounds
-	return Cell.X >= 0 && Cell.X < GridActor->XCount && Cell.Y >= 0 && Cell.Y < GridActor->YCount;
+	OnPathComplete.Broadcast(this, State);
 }
 
 
-
-static void FindNeighbors(const AGAGridActor* GridActor, const FCellRef& CurrentCell, TArray<FCellRef>& Neighbors)
+void UGAPathComponent::RequestPathAsync()
 {
-	Neighbors.Empty();
+	CancelAsyncPath();
 
-	if (!GridActor)
+	const AGAGridActor* Grid = GetGridActor();
+	APawn* OwnerPawn = GetOwnerPawn();
+	if (!Grid || !OwnerPawn || !DestinationCell.IsValid())
 	{
-		// Handle the case where the grid actor is not available
 		return;
 	}
 
-	// Assuming a fixed grid step size
-	const int32 GridStep = 1;
+	const FCellRef StartCell = Grid->GetCellRef(OwnerPawn->GetActorLocation(), true);
 
-	// Add neighboring cell references based on the grid step size
-	for (int32 YOffset = -1; YOffset <= 1; ++YOffset)
+	// A cache hit is cheaper than launching a task, so take it right away
+	TArray<FCellRef> CachedPath;
+	FGAPathCache* PathCache = GetPathCache();
+	if (PathCache && PathCache->Find(StartCell, DestinationCell, GetPathCacheOptions(GAPM_AStar), Grid->GetGridVersion(), CachedPath))
 	{
-		for (int32 XOffset = -1; XOffset <= 1; ++XOffset)
+		State = SetStepsFromPath(Grid, CachedPath);
+		OnPathComplete.Broadcast(this, State);
+		return;
+	}
+
+	// No point spinning up a task to find out the goal's on an island
+	if (!Grid->AreConnected(StartCell, DestinationCell))
+	{
+		Steps.Reset();
+		State = GAPS_Invalid;
+		OnPathComplete.Broadcast(this, State);
+		return;
+	}
+
+	TSharedRef<FGAAsyncPathQuery, ESPMode::ThreadSafe> Query = MakeShared<FGAAsyncPathQuery, ESPMode::ThreadSafe>();
+	Query->Snapshot = Grid->GetSnapshot();
+	Query->StartCell = StartCell;
+	Query->GoalCell = DestinationCell;
+	Query->MinClearance = GetMinClearance();
+
+	// Search arrays are borrowed from the world's pool, so they get reused between queries but go with the world
+	UWorld* World = GetWorld();
+	UGAPathRequestSubsystem* Subsystem = World ? World->GetSubsystem<UGAPathRequestSubsystem>() : nullptr;
+	TSharedPtr<FGASearchPool, ESPMode::ThreadSafe> SearchPool;
+	if (Subsystem)
+	{
+		SearchPool = Subsystem->GetSearchPool();
+	}
+
+	Query->Task = UE::Tasks::Launch(UE_SOURCE_LOCATION, [Query, SearchPool]()
+	{
+		TUniquePtr<FGAGridSearch> WorkerSearch = SearchPool.IsValid() ? SearchPool->Acquire() : MakeUnique<FGAGridSearch>();
+
+		WorkerSearch->SetMinClearance(Query->MinClearance);
+		if (WorkerSearch->BeginAStar(*Query->Snapshot, Query->StartCell, Query->GoalCell))
 		{
-			// Skip the current cell
-			if (XOffset == 0 && YOffset == 0)
+			// Slice the search so a cancelled query stops promptly
+			EGASearchStatus Status = EGASearchStatus::InProgress;
+			while ((Status == EGASearchStatus::InProgress) && !Query->bCancelled.load(std::memory_order_relaxed))
 			{
-				continue;
+				Status = WorkerSearch->StepAStar(4096, Query->PathCells);
 			}
+			Query->bFound = (Status == EGASearchStatus::Found);
+		}
 
-			FCellRef NeighborCell(CurrentCell.X + XOffset * GridStep, CurrentCell.Y + YOffset * GridStep);
-			if (IsCellValid(GridActor, NeighborCell))
-			{
-				Neighbors.Add(NeighborCell);
-			}
+		if (SearchPool.IsValid())
+		{
+			SearchPool->Release(MoveTemp(WorkerSearch));
 		}
-	}
-}
+	});
 
+	AsyncQuery = Query;
+}
 
 
-static void dijkstra(const FVector& StartPoint, FGAGridMap& DistanceMap, TMap<FCellRef, FVector>& CameFrom, const AGAGridActor* GridActor)
+void UGAPathComponent::CancelAsyncPath()
 {
-	// Initialize all distances as INFINITE and set sptSet[] as false
-	TMap<FCellRef, float> dist;
-	TMap<FCellRef, bool> sptSet;
-
-	// Initialize all distances as INFINITE and sptSet[] as false
-	for (int32 Y = DistanceMap.GridBounds.MinY; Y <= DistanceMap.GridBounds.MaxY; ++Y)
+	if (AsyncQuery.IsValid())
 	{
-		for (int32 X = DistanceMap.GridBounds.MinX; X <= DistanceMap.GridBounds.MaxX; ++X)
-		{
-			FCellRef CellRef(X, Y);
-			dist.Add(CellRef, FLT_MAX);
-			sptSet.Add(CellRef, false);
-		}
+		// The task holds its own reference, so we can just let go of it
+		AsyncQuery->bCancelled = true;
+		AsyncQuery.Reset();
 	}
+}
 
-	// Distance of source vertex from itself is always 0
-	FCellRef SourceVertex = GridActor->GetCellRef(StartPoint);
-	dist.Add(SourceVertex, 0);
 
-	int32 Area = (DistanceMap.GridBounds.MaxX - DistanceMap.GridBounds.MinX + 1) *
-		(DistanceMap.GridBounds.MaxY - DistanceMap.GridBounds.MinY + 1);
+void UGAPathComponent::ApplyAsyncPath()
+{
+	TSharedPtr<FGAAsyncPathQuery, ESPMode::ThreadSafe> Query = MoveTemp(AsyncQuery);
+	AsyncQuery.Reset();
 
-	// Find shortest path for all vertices
-	for (int count = 0; count < Area - 1; count++)
+	const AGAGridActor* Grid = GetGridActor();
+	if (Query->bFound && Grid)
 	{
-		// Pick the minimum distance vertex from the set of vertices not yet processed
-		FCellRef u;
-		float minDist = FLT_MAX;
-		for (const auto& Pair : dist)
-		{
-			if (!sptSet[Pair.Key] && Pair.Value <= minDist)
-			{
-				minDist = Pair.Value;
-				u = Pair.Key;
-			}
-		}
+		State = SetStepsFromPath(Grid, Query->PathCells);
 
-		// Mark the picked vertex as processed
-		sptSet[u] = true;
-
-		// Update dist value of the adjacent vertices of the picked vertex
-		TArray<FCellRef> Neighbors;
-		// Assuming FindNeighbors returns neighboring cell references
-		FindNeighbors(GridActor, u, Neighbors);
-		for (const FCellRef& Neighbor : Neighbors)
+		FGAPathCache* PathCache = GetPathCache();
+		if (PathCache && (Query->Snapshot->GridVersion == Grid->GetGridVersion()))
 		{
-			// Update dist[v] only if it's not in sptSet and there is a path from u to v
-			if (!sptSet[Neighbor] && dist[u] != FLT_MAX)
-			{
-				// Assuming all edges have a weight of 1, so we increment the distance by 1
-				dist[Neighbor] = dist[u] + 1;
-
-				// Store the predecessor for path reconstruction
-				FVector NeighborWorldPos = GridActor->GetCellPosition(Neighbor);
-				CameFrom.Add(Neighbor, NeighborWorldPos);
-			}
+			PathCache->Add(Query->PathCells, GetPathCacheOptions(GAPM_AStar), Query->Snapshot->GridVersion);
 		}
 	}
+	else
+	{
+		Steps.Reset();
+		State = GAPS_Invalid;
+	}
 
-	// Copy the computed distances to DistanceMap
-	for (const auto& Pair : dist)
+	// The grid changed while we were searching. Use what we got for now, but plan again.
+	if (Grid && (Query->Snapshot->GridVersion != Grid->GetGridVersion()))
 	{
-		DistanceMap.SetValue(Pair.Key, Pair.Value);
+		RequestPathRebuild();
 	}
+
+	OnPathComplete.Broadcast(this, State);
 }
 
-EGAPathState UGAPathComponent::AStar()
+
+uint8 UGAPathComponent::GetMinClearance() const
+{
+	const AGAGridActor* Grid = GetGridActor();
+	return (Grid && (AgentRadius > 0.0f)) ? Grid->GetClearanceForRadius(AgentRadius) : 0;
+}
+
+
+uint32 UGAPathComponent::GetPathCacheOptions(EGAPathSearchMode Mode) const
 {
+	return uint32(Mode) | (uint32(GetMinClearance()) << 8);
+}
+
 
-	return GAPS_Finished;
+bool UGAPathComponent::IsScheduledPathPending() const
+{
+	UWorld* World = GetWorld();
+	UGAPathRequestSubsystem* Subsystem = World ? World->GetSubsystem<UGAPathRequestSubsystem>() : nullptr;
+	return Subsystem && Subsystem->IsPathPending(this);
 }
 
 
-bool UGAPathComponent::Dijkstra(const FVector& StartPoint, FGAGridMap& DistanceMapOut, TMap<FCellRef, FVector>& CameFrom)
+FGAPathCache* UGAPathComponent::GetPathCache() const
+{
+	UWorld* World = GetWorld();
+	UGAPathRequestSubsystem* Subsystem = World ? World->GetSubsystem<UGAPathRequestSubsystem>() : nullptr;
+	return Subsystem ? &Subsystem->GetPathCache() : nullptr;
+}
+
+
+bool UGAPathComponent::Dijkstra(const FVector& StartPoint, FGAGridMap& DistanceMapOut, TArray<FGASparseCell>* ReachableOut)
 {
 	const AGAGridActor* Grid = GetGridActor();
 
@@ -360,77 +504,186 @@ bool UGAPathComponent::Dijkstra(const FVector& StartPoint, FGAGridMap& DistanceM
 		return false;
 	}
 
-	// Initialize a grid to store distances
+	FCellRef StartCell = Grid->GetCellRef(StartPoint);
+	Search.SetMinClearance(GetMinClearance());
+	if (!Search.Dijkstra(Grid, StartCell, DistanceMapOut, ReachableOut))
+	{
+		return false;
+	}
+
+	return true;
+}
+
+void UGAPathComponent::FollowPath()
+{
+	AActor* Owner = GetOwnerPawn();
+	FVector StartPoint = Owner->GetActorLocation();
 
-	// Run Dijkstra's algorithm
-	dijkstra(StartPoint, DistanceMapOut, CameFrom, Grid);
+	check(State == GAPS_Active);
+	check(Steps.Num() > 0);
 
-	// Reconstruct the path from the start point to the destination
-	/*FVector GoalPoint = Destination;
-	TArray<FVector> PathPoints;
-	CameFromToPath(CameFrom, StartPoint, GoalPoint, PathPoints, Grid);
-	UE_LOG(LogTemp, Warning, TEXT("PathPoints after CameFromToPath:"));
-	for (const FVector& Point : PathPoints)
+	if (FVector::Dist(StartPoint, Destination) <= ArrivalDistance)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Point: %s"), *Point.ToString());
+		// Yay! We got there!
+		State = GAPS_Finished;
+		return;
 	}
 
-	// Convert the array of points to Steps array
-	Steps.SetNum(PathPoints.Num());
-	int32 i = 0;
-	for (const FVector& Point : PathPoints)
+	// The grid changed under us. See if what's left of the path still works, and patch up just the broken part if not.
+	const AGAGridActor* Grid = GetGridActor();
+	if (Grid && (SearchMode != GAPM_FlowField) && (StepsGridVersion != Grid->GetGridVersion()))
 	{
-		FCellRef CellRef = Grid->GetCellRef(Point);
-		ECellData CellData = Grid->GetCellData(CellRef);
-		// Check if the cell is traversable
-		if (CellData == ECellData::CellDataTraversable)
+		// The incremental planner does its own repairs, and only of what changed
+		StepsGridVersion = Grid->GetGridVersion();
+		if ((SearchMode == GAPM_Incremental) || !RepairBlockedSteps(Grid))
 		{
-			Steps[i].Set(FVector2D(Point.X, Point.Y), CellRef);
-			++i;
+			RequestPathRebuild();
 		}
 	}
-	*/
 
+	// Move on past any corners we've reached. The last step is the destination itself, we stop there.
+	StepCursor = FMath::Clamp(StepCursor, 0, Steps.Num() - 1);
+	const FVector2D Location2D(StartPoint);
+	while ((StepCursor < Steps.Num() - 1) && (FVector2D::DistSquared(Location2D, Steps[StepCursor].Point) <= FMath::Square(StepReachedDistance)))
+	{
+		StepCursor++;
+	}
+
+	FVector V = FVector(Steps[StepCursor].Point, StartPoint.Z) - StartPoint;
+	V.Normalize();
+
+	if (UNavMovementComponent* Movement = GetMovementComponent())
+	{
+		Movement->RequestPathMove(V);
+	}
+}
+
+
+UNavMovementComponent* UGAPathComponent::GetMovementComponent()
+{
+	APawn* OwnerPawn = GetOwnerPawn();
+	UNavMovementComponent* Result = MovementComponent.Get();
+
+	// Only look it up again the first time, or if the controller has moved on to another pawn
+	if (!Result || (Result->GetOwner() != OwnerPawn))
+	{
+		Result = OwnerPawn ? OwnerPawn->FindComponentByClass<UNavMovementComponent>() : nullptr;
+		MovementComponent = Result;
+	}
+	return Result;
+}
+
+
+FCellRef UGAPathComponent::GetStepStartCell(const AGAGridActor* Grid, int32 StepIndex)
+{
+	if (StepIndex > StepCursor)
+	{
+		return Steps[StepIndex - 1].CellRef;
+	}
+
+	// The step we're on starts wherever we are now
+	APawn* OwnerPawn = GetOwnerPawn();
+	return OwnerPawn ? Grid->GetCellRef(OwnerPawn->GetActorLocation(), true) : FCellRef::Invalid;
+}
+
+
+bool UGAPathComponent::ReplaceSteps(const AGAGridActor* Grid, const FCellRef& FromCell, int32 FirstStep, int32 LastStep, const FCellRef& ToCell, const FVector2D& LastPoint)
+{
+	TArray<FCellRef> PathCells;
+	Search.SetMinClearance(GetMinClearance());
+	if (!Search.AStar(Grid, FromCell, ToCell, PathCells))
+	{
+		return false;
+	}
 
-	// Update the DistanceMapOut if needed
-	// For now, let's just log a warning message
-	UE_LOG(LogTemp, Warning, TEXT("Dijkstra's algorithm completed!"));
+	if (bStringPullPaths)
+	{
+		FGAGridSearch::StringPull(Grid, GetMinClearance(), PathCells);
+	}
 
-	/*UE_LOG(LogTemp, Warning, TEXT("Printing Steps:"));
-	for (const auto& Step : Steps)
+	// Same as SetStepsFromPath: skip the cell we start from, and the last step ends on LastPoint
+	TArray<FPathStep> NewSteps;
+	NewSteps.SetNum(FMath::Max(PathCells.Num() - 1, 1));
+	for (int32 Index = 1; Index < PathCells.Num(); Index++)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("Step: Point(%f, %f), CellRef(%d, %d)"),
-			Step.Point.X, Step.Point.Y, Step.CellRef.X, Step.CellRef.Y);
+		NewSteps[Index - 1].Set(FVector2D(Grid->GetCellPosition(PathCells[Index])), PathCells[Index]);
 	}
-	*/
+	NewSteps.Last().Set(LastPoint, ToCell);
+
+	Steps.RemoveAt(FirstStep, (LastStep - FirstStep) + 1, false);
+	Steps.Insert(NewSteps, FirstStep);
 	return true;
 }
 
-void UGAPathComponent::FollowPath()
+
+bool UGAPathComponent::RepairBlockedSteps(const AGAGridActor* Grid)
 {
-	AActor* Owner = GetOwnerPawn();
-	FVector StartPoint = Owner->GetActorLocation();
+	// Line of sight doesn't know about clearance, so we can't tell what a bigger agent can still get through
+	if ((GetMinClearance() > 1) || (StepCursor >= Steps.Num()))
+	{
+		return false;
+	}
 
-	check(State == GAPS_Active);
-	check(Steps.Num() > 0);
+	// Find the stretch of the remaining path that's now blocked. Everything before it and after it can stay.
+	int32 FirstBlocked = INDEX_NONE;
+	int32 LastBlocked = INDEX_NONE;
+	for (int32 StepIndex = StepCursor; StepIndex < Steps.Num(); StepIndex++)
+	{
+		if (!Grid->HasCellLineOfSight(GetStepStartCell(Grid, StepIndex), Steps[StepIndex].CellRef))
+		{
+			FirstBlocked = (FirstBlocked == INDEX_NONE) ? StepIndex : FirstBlocked;
+			LastBlocked = StepIndex;
+		}
+	}
 
-	// Always follow the first step, assuming that we are refreshing the whole path every tick
-	FVector V = FVector(Steps[0].Point, 0.0f) - StartPoint;
-	V.Normalize();
+	if (FirstBlocked == INDEX_NONE)
+	{
+		return true;
+	}
+
+	// Plan around it, from the start of the first blocked step back to the end of the last one
+	const FPathStep RejoinStep = Steps[LastBlocked];
+	return ReplaceSteps(Grid, GetStepStartCell(Grid, FirstBlocked), FirstBlocked, LastBlocked, RejoinStep.CellRef, RejoinStep.Point);
+}
+
+
+bool UGAPathComponent::RepairDestination(const AGAGridActor* Grid)
+{
+	if ((StepCursor >= Steps.Num()) || (StepsGridVersion != Grid->GetGridVersion()))
+	{
+		return false;
+	}
+
+	FPathStep& LastStep = Steps.Last();
+	if (LastStep.CellRef == DestinationCell)
+	{
+		// Still the same cell
+		LastStep.Point = FVector2D(Destination);
+		return true;
+	}
 
-	UNavMovementComponent* MovementComponent = Owner->FindComponentByClass<UNavMovementComponent>();
-	if (MovementComponent)
+	// If we can see the new destination from the last corner, we just head straight there from it instead
+	const int32 LastIndex = Steps.Num() - 1;
+	const FCellRef FromCell = GetStepStartCell(Grid, LastIndex);
+	if (bStringPullPaths && (GetMinClearance() <= 1) && Grid->HasCellLineOfSight(FromCell, DestinationCell))
 	{
-		MovementComponent->RequestPathMove(V);
+		LastStep.Set(FVector2D(Destination), DestinationCell);
+		return true;
 	}
+
+	// Otherwise re-plan just the last leg
+	return ReplaceSteps(Grid, FromCell, LastIndex, LastIndex, DestinationCell, FVector2D(Destination));
 }
 
 
 
-EGAPathState UGAPathComponent::SetDestination(const FVector& DestinationPoint, TMap<FCellRef, FVector>& CameFrom)
+EGAPathState UGAPathComponent::SetDestination(const FVector& DestinationPoint)
 {
 	Destination = DestinationPoint;
 
+	// We're about to plan right here, so anything still in flight is out of date
+	CancelAsyncPath();
+
 	State = GAPS_Invalid;
 	bDestinationValid = true;
 
@@ -443,8 +696,6 @@ EGAPathState UGAPathComponent::SetDestination(const FVector& DestinationPoint, T
 			DestinationCell = CellRef;
 			bDestinationValid = true;
 
-			RequestPathRebuild();
-			SetCameFrom(CameFrom);
 			RefreshPath();
 		}
 	}
@@ -460,7 +711,26 @@ void UGAPathComponent::RequestPathRebuild()
 void UGAPathComponent::SetDestinationAndRebuildPath(const FVector& DestinationPoint)
 {
 	Destination = DestinationPoint;
-	bDestinationValid = true;
+	bDestinationValid = false;
+
+	const AGAGridActor* Grid = GetGridActor();
+	if (Grid)
+	{
+		DestinationCell = Grid->GetCellRef(Destination, true);
+		bDestinationValid = DestinationCell.IsValid();
+	}
+
+	// If the destination has only drifted a little from where the path was planned to, and nothing else is on the way,
+	// just patch up the end of the path we've got. The limit is on the drift since the last full plan, so patches can't
+	// pile up into a badly roundabout path.
+	const bool bCanRepair = Grid && bDestinationValid && (State == GAPS_Active) && (SearchMode != GAPM_FlowField) &&
+		(SearchMode != GAPM_Incremental) && !bRebuildPathRequested && !IsAsyncPathPending() && !IsScheduledPathPending() && PlannedDestinationCell.IsValid() &&
+		(FMath::Max(FMath::Abs(DestinationCell.X - PlannedDestinationCell.X), FMath::Abs(DestinationCell.Y - PlannedDestinationCell.Y)) <= DestinationRepairCells);
+	if (bCanRepair && RepairDestination(Grid))
+	{
+		return;
+	}
+
 	RequestPathRebuild();
 }
 
@@ -3,8 +3,15 @@
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
 #include "GameAI/Grid/GAGridActor.h"
+#include "GAGridSearch.h"
+#include "GADStarLite.h"
+#include "Tasks/Task.h"
+#include <atomic>
 #include "GAPathComponent.generated.h"
 
+class FGAPathCache;
+class UNavMovementComponent;
+
 
 
 USTRUCT(BlueprintType)
@@ -38,6 +45,42 @@ enum EGAPathState
 };
 
 
+// Which search a path component uses to get from A to B
+UENUM(BlueprintType)
+enum EGAPathSearchMode
+{
+	GAPM_AStar			UMETA(DisplayName = "A*"),
+	GAPM_JumpPoint		UMETA(DisplayName = "Jump Point Search"),		// JPS+ -- needs the grid's jump point table
+	GAPM_Hierarchical	UMETA(DisplayName = "Hierarchical (HPA*)"),	// needs the grid's cluster graph (bBuildHierarchy)
+	GAPM_FlowField		UMETA(DisplayName = "Flow Field"),			// shares a field with everyone else going to the same cell
+	GAPM_Incremental	UMETA(DisplayName = "Incremental (D* Lite)"),	// keeps its search between replans, for chasing a moving destination
+};
+
+
+// An A* running on a worker thread, against a snapshot of the grid
+// Owned jointly by the path component and the task, so it's fine for either to go away first.
+struct FGAAsyncPathQuery
+{
+	TSharedPtr<const FGAGridSnapshot, ESPMode::ThreadSafe> Snapshot;
+	FCellRef StartCell;
+	FCellRef GoalCell;
+
+	uint8 MinClearance = 0;
+
+	// Set by the game thread when the query is superseded; the worker checks it every so often and gives up
+	std::atomic<bool> bCancelled = false;
+
+	// Written by the worker, only read once Task has completed
+	bool bFound = false;
+	TArray<FCellRef> PathCells;
+
+	UE::Tasks::FTask Task;
+};
+
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FGAOnPathComplete, UGAPathComponent*, PathComponent, TEnumAsByte<EGAPathState>, State);
+
+
 // Our custom path following component, which will rely on the data
 // contained in the GridActor
 // Note the meta-specific "BlueprintSpawnableComponnet". This will allow us
@@ -50,7 +93,11 @@ class UGAPathComponent : public UActorComponent
 	GENERATED_UCLASS_BODY()
 
 private:
-	TMap<FCellRef, FVector> CachedCameFrom;
+	// Scratch state for our searches, kept around so we don't reallocate every query
+	FGAGridSearch Search;
+
+	// The search tree for GAPM_Incremental, kept from one replan to the next
+	FGADStarLite IncrementalPlanner;
 	
 public:
 
@@ -71,33 +118,91 @@ public:
 
 	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
-	void SetCameFrom(const TMap<FCellRef, FVector>& InCameFrom);
-
-	EGAPathState GoThere(TMap<FCellRef, FVector>& CameFrom);
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	EGAPathState RefreshPath();
 
+	// Plan a path from the owner's current cell to DestinationCell and write it into Steps, using SearchMode
 	EGAPathState AStar();
 
-	bool Dijkstra(const FVector& StartPoint, FGAGridMap& DistanceMapOut, TMap<FCellRef, FVector>& CameFrom);
+	// Fill in the path distance to every cell of DistanceMapOut reachable from StartPoint
+	// Use this for field queries (e.g. the spatial component) -- for getting from A to B, AStar is much cheaper
+	// ReachableOut (optional) gets the reached cells in settle order, see FGAGridSearch::Dijkstra
+	bool Dijkstra(const FVector& StartPoint, FGAGridMap& DistanceMapOut, TArray<FGASparseCell>* ReachableOut = nullptr);
+
+
+	// The path request subsystem is done with our request (see RequestPath / UGAPathRequestSubsystem)
+	void CompleteScheduledPath(bool bFound, const TArray<FCellRef>& PathCells);
+
+	// Plan a path to DestinationCell on a worker thread. Steps and State are updated at the start of the first tick
+	// after it finishes; until then we carry on with the old path. Supersedes any async query already running.
+	// Always plain A*, since the snapshot only has the traversability (no jump table or hierarchy).
+	void RequestPathAsync();
 
-	// bool Dijkstra(const FVector& StartPoint, FGAGridMap& DistanceMapOut);
+	void CancelAsyncPath();
 
+	bool IsAsyncPathPending() const { return AsyncQuery.IsValid(); }
+
+	// We've a path request queued up with (or being sliced by) the world's UGAPathRequestSubsystem
+	bool IsScheduledPathPending() const;
+
+	// Fires when a queued or async path request finishes, with the resulting state
+	UPROPERTY(BlueprintAssignable)
+	FGAOnPathComplete OnPathComplete;
 
 	void FollowPath();
 
+	// Flow field mode: look up the next step from the shared field for our destination, rather than keeping a path
+	EGAPathState UpdateFlowFieldStep();
+
 	// Parameters ------------------------
 
 	// When I'm within this distance of my destination, my path is considered finished.
 	UPROPERTY(BlueprintReadWrite, EditAnywhere)
 	float ArrivalDistance;
 
+	// Our pawn's radius. Paths keep at least this far from anything blocked (see AGAGridActor::GetClearance).
+	// 0 means just stick to traversable cells.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	float AgentRadius;
+
+	// The clearance our cells need for AgentRadius
+	uint8 GetMinClearance() const;
+
+	// Path cache key for a search in the given mode. Covers everything that changes the result, i.e. the clearance too.
+	uint32 GetPathCacheOptions(EGAPathSearchMode Mode) const;
+
+	// Jump point search is a lot cheaper on big open maps, and gives paths of the same length
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	TEnumAsByte<EGAPathSearchMode> SearchMode;
+
+	// Rebuilds go through the world's UGAPathRequestSubsystem, so they're spread over a few frames rather than all
+	// landing at once. SetDestination still plans immediately.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	bool bUsePathScheduler;
+
+	// Rebuilds run on a worker thread instead (see RequestPathAsync). Takes precedence over bUsePathScheduler.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	bool bUseAsyncSearch;
+
+	// Cut paths down to their corners (see FGAGridSearch::StringPull), so we walk straight lines between them instead
+	// of every cell step. Fewer Steps, and much less jagged.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	bool bStringPullPaths;
+
+	// How close we need to get to a corner of the path before moving on to the next one
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	float StepReachedDistance;
+
+	// SetDestinationAndRebuildPath patches the end of the current path, rather than planning again from scratch, as long
+	// as the destination stays within this many cells of where the path was planned to. 0 to always re-plan.
+	UPROPERTY(BlueprintReadWrite, EditAnywhere)
+	int32 DestinationRepairCells;
+
 	// Destination ------------------------
 
 	UFUNCTION(BlueprintCallable)
-	// EGAPathState SetDestination(const FVector& DestinationPoint);
-
-	EGAPathState SetDestination(const FVector& DestinationPoint, TMap<FCellRef, FVector>& CameFrom);
+	EGAPathState SetDestination(const FVector& DestinationPoint);
 
 	void RequestPathRebuild();
 
@@ -128,4 +233,45 @@ public:
 	UPROPERTY(BlueprintReadWrite)
 	TArray<FPathStep> Steps;
 
+	// The step we're heading for. The ones before it have been reached.
+	UPROPERTY(BlueprintReadOnly)
+	int32 StepCursor;
+
+private:
+	// Our pawn's movement component, only looked up again if the pawn changes
+	UNavMovementComponent* GetMovementComponent();
+
+	TWeakObjectPtr<UNavMovementComponent> MovementComponent;
+
+	// Where the given step starts from: the previous step, or for the step we're on, our current cell
+	FCellRef GetStepStartCell(const AGAGridActor* Grid, int32 StepIndex);
+
+	// Plan from FromCell to ToCell, and put the result in place of Steps[FirstStep..LastStep].
+	// The new last step ends on LastPoint. Leaves Steps alone and returns false if there's no way through.
+	bool ReplaceSteps(const AGAGridActor* Grid, const FCellRef& FromCell, int32 FirstStep, int32 LastStep, const FCellRef& ToCell, const FVector2D& LastPoint);
+
+	// The grid has changed: re-plan just the part of the remaining path that's now blocked, if any
+	// False if that didn't work out, and the whole path needs rebuilding.
+	bool RepairBlockedSteps(const AGAGridActor* Grid);
+
+	// The destination has moved a little: re-plan just the last leg of the path to reach it
+	bool RepairDestination(const AGAGridActor* Grid);
+
+	// The grid version Steps were checked against
+	uint32 StepsGridVersion = 0;
+
+	// The cell the current Steps were fully planned to. Normally DestinationCell, unless the destination has moved since.
+	FCellRef PlannedDestinationCell;
+
+	// Turn the cells of a path into Steps, returning the resulting state
+	EGAPathState SetStepsFromPath(const AGAGridActor* Grid, const TArray<FCellRef>& PathCells);
+
+	// Pick up the result of a finished async query
+	void ApplyAsyncPath();
+
+	// The world's shared path cache (see FGAPathCache), if there is one
+	FGAPathCache* GetPathCache() const;
+
+	TSharedPtr<FGAAsyncPathQuery, ESPMode::ThreadSafe> AsyncQuery;
+
 };
@@ -0,0 +1,334 @@
+#include "GAPathRequestSubsystem.h"
+#include "GAPathComponent.h"
+#include "GameAI/GameAI.h"
+#include "Kismet/GameplayStatics.h"
+
+DECLARE_CYCLE_STAT(TEXT("GA Path Requests"), STAT_GAPathRequests, STATGROUP_GameAI);
+DECLARE_DWORD_COUNTER_STAT(TEXT("GA Queued Path Requests"), STAT_GAQueuedPathRequests, STATGROUP_GameAI);
+
+
+static TAutoConsoleVariable<float> CVarPathRequestBudgetUs(
+	TEXT("GameAI.PathRequestBudgetUs"),
+	1000.0f,
+	TEXT("Time, in microseconds, the path request subsystem may spend on queued searches each frame."));
+
+
+static FAutoConsoleCommandWithWorld PathCacheStatsCommand(
+	TEXT("GameAI.PathCacheStats"),
+	TEXT("Log the size and hit rate of the shared path cache."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UGAPathRequestSubsystem* Subsystem = World ? World->GetSubsystem<UGAPathRequestSubsystem>() : nullptr)
+		{
+			Subsystem->GetPathCache().LogStats();
+		}
+	}));
+
+
+static FAutoConsoleCommandWithWorld SearchPoolStatsCommand(
+	TEXT("GameAI.SearchPoolStats"),
+	TEXT("Log how many search contexts async path queries have needed, and the memory held by the idle ones."),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UGAPathRequestSubsystem* Subsystem = World ? World->GetSubsystem<UGAPathRequestSubsystem>() : nullptr)
+		{
+			Subsystem->GetSearchPool()->LogStats();
+		}
+	}));
+
+
+TUniquePtr<FGAGridSearch> FGASearchPool::Acquire()
+{
+	{
+		FScopeLock ScopeLock(&Lock);
+		if (FreeSearches.Num() > 0)
+		{
+			return FreeSearches.Pop(false);
+		}
+		CreatedCount++;
+	}
+
+	// Allocated outside the lock. Its arrays only get sized by its first query anyway.
+	return MakeUnique<FGAGridSearch>();
+}
+
+
+void FGASearchPool::Release(TUniquePtr<FGAGridSearch> Search)
+{
+	if (Search.IsValid())
+	{
+		FScopeLock ScopeLock(&Lock);
+		FreeSearches.Add(MoveTemp(Search));
+	}
+}
+
+
+int32 FGASearchPool::GetCreatedCount() const
+{
+	FScopeLock ScopeLock(&Lock);
+	return CreatedCount;
+}
+
+
+SIZE_T FGASearchPool::GetAllocatedSize() const
+{
+	FScopeLock ScopeLock(&Lock);
+	SIZE_T Size = FreeSearches.GetAllocatedSize();
+	for (const TUniquePtr<FGAGridSearch>& Search : FreeSearches)
+	{
+		Size += sizeof(FGAGridSearch) + Search->GetAllocatedSize();
+	}
+	return Size;
+}
+
+
+void FGASearchPool::LogStats() const
+{
+	int32 FreeCount;
+	{
+		FScopeLock ScopeLock(&Lock);
+		FreeCount = FreeSearches.Num();
+	}
+	UE_LOG(LogTemp, Log, TEXT("Search pool: %d searches made, %d idle (%llu bytes)"), GetCreatedCount(), FreeCount, uint64(GetAllocatedSize()));
+}
+
+
+TStatId UGAPathRequestSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UGAPathRequestSubsystem, STATGROUP_Tickables);
+}
+
+
+void UGAPathRequestSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GAPathRequests);
+
+	const double Deadline = FPlatformTime::Seconds() + double(CVarPathRequestBudgetUs.GetValueOnGameThread()) * 1.0e-6;
+
+	// Always do at least one slice, so nothing starves even with a tiny budget
+	do
+	{
+		if (ActivePath.IsValid())
+		{
+			StepActivePath();
+		}
+		else if (!StartNextRequest())
+		{
+			break;
+		}
+	}
+	while (FPlatformTime::Seconds() < Deadline);
+
+	SET_DWORD_STAT(STAT_GAQueuedPathRequests, Requests.Num() + (ActivePath.IsValid() ? 1 : 0));
+}
+
+
+void UGAPathRequestSubsystem::RequestPath(UGAPathComponent* PathComponent)
+{
+	if (!PathComponent)
+	{
+		return;
+	}
+
+	double RequestTime = FPlatformTime::Seconds();
+	if (ActivePath.Get() == PathComponent)
+	{
+		// Start over with the new destination, but don't lose our place in the queue
+		RequestTime = ActivePathRequestTime;
+		ActivePath.Reset();
+	}
+	else if (Requests.ContainsByPredicate([PathComponent](const FRequest& Request) { return Request.PathComponent.Get() == PathComponent; }))
+	{
+		return;
+	}
+
+	FRequest& Request = Requests.AddDefaulted_GetRef();
+	Request.PathComponent = PathComponent;
+	Request.RequestTime = RequestTime;
+}
+
+
+void UGAPathRequestSubsystem::CancelPath(UGAPathComponent* PathComponent)
+{
+	if (ActivePath.Get() == PathComponent)
+	{
+		ActivePath.Reset();
+	}
+	Requests.RemoveAll([PathComponent](const FRequest& Request) { return Request.PathComponent.Get() == PathComponent; });
+}
+
+
+bool UGAPathRequestSubsystem::IsPathPending(const UGAPathComponent* PathComponent) const
+{
+	return PathComponent && ((ActivePath.Get() == PathComponent) ||
+		Requests.ContainsByPredicate([PathComponent](const FRequest& Request) { return Request.PathComponent.Get() == PathComponent; }));
+}
+
+
+void UGAPathRequestSubsystem::RequestDijkstra(const AGAGridActor* Grid, const FCellRef& StartCell, const FGridBox& Bounds, FGAOnDijkstraComplete OnComplete, uint8 MinClearance)
+{
+	FRequest& Request = Requests.AddDefaulted_GetRef();
+	Request.Grid = Grid;
+	Request.StartCell = StartCell;
+	Request.Bounds = Bounds;
+	Request.MinClearance = MinClearance;
+	Request.OnDijkstraComplete = MoveTemp(OnComplete);
+	Request.RequestTime = FPlatformTime::Seconds();
+}
+
+
+float UGAPathRequestSubsystem::GetPriority(const FRequest& Request, const FVector& PlayerLocation, double Now) const
+{
+	FVector Location = PlayerLocation;
+	if (UGAPathComponent* PathComponent = Request.PathComponent.Get())
+	{
+		if (const APawn* Pawn = PathComponent->GetOwnerPawn())
+		{
+			Location = Pawn->GetActorLocation();
+		}
+	}
+	else if (const AGAGridActor* Grid = Request.Grid.Get())
+	{
+		Location = Grid->GetCellPosition(Request.StartCell);
+	}
+
+	// Higher is more urgent
+	return float(Now - Request.RequestTime) * StalenessWeight - float(FVector::Dist2D(Location, PlayerLocation));
+}
+
+
+bool UGAPathRequestSubsystem::StartNextRequest()
+{
+	// Forget about anything whose owner has gone away
+	Requests.RemoveAllSwap([](const FRequest& Request) { return !Request.PathComponent.IsValid() && !Request.Grid.IsValid(); });
+
+	if (Requests.Num() == 0)
+	{
+		return false;
+	}
+
+	const APawn* PlayerPawn = UGameplayStatics::GetPlayerPawn(this, 0);
+	const FVector PlayerLocation = PlayerPawn ? PlayerPawn->GetActorLocation() : FVector::ZeroVector;
+	const double Now = FPlatformTime::Seconds();
+
+	// The queue is short, so a linear scan beats keeping a heap whose priorities change every frame
+	int32 BestIndex = 0;
+	float BestPriority = GetPriority(Requests[0], PlayerLocation, Now);
+	for (int32 Index = 1; Index < Requests.Num(); Index++)
+	{
+		const float Priority = GetPriority(Requests[Index], PlayerLocation, Now);
+		if (Priority > BestPriority)
+		{
+			BestIndex = Index;
+			BestPriority = Priority;
+		}
+	}
+
+	FRequest Request = MoveTemp(Requests[BestIndex]);
+	Requests.RemoveAtSwap(BestIndex);
+
+	if (UGAPathComponent* PathComponent = Request.PathComponent.Get())
+	{
+		ActivePathRequestTime = Request.RequestTime;
+		StartPathRequest(PathComponent);
+	}
+	else
+	{
+		RunDijkstraRequest(Request);
+	}
+
+	return true;
+}
+
+
+void UGAPathRequestSubsystem::StartPathRequest(UGAPathComponent* PathComponent)
+{
+	const AGAGridActor* Grid = PathComponent->GetGridActor();
+	APawn* Pawn = PathComponent->GetOwnerPawn();
+	TArray<FCellRef> PathCells;
+
+	if (!Grid || !Pawn || !PathComponent->DestinationCell.IsValid())
+	{
+		PathComponent->CompleteScheduledPath(false, PathCells);
+		return;
+	}
+
+	const FCellRef StartCell = Grid->GetCellRef(Pawn->GetActorLocation(), true);
+	const FCellRef& GoalCell = PathComponent->DestinationCell;
+	Search.SetMinClearance(PathComponent->GetMinClearance());
+
+	if (PathCache.Find(StartCell, GoalCell, PathComponent->GetPathCacheOptions(PathComponent->SearchMode), Grid->GetGridVersion(), PathCells))
+	{
+		PathComponent->CompleteScheduledPath(true, PathCells);
+		return;
+	}
+
+	bool bFound = false;
+	switch (PathComponent->SearchMode)
+	{
+	case GAPM_JumpPoint:
+		bFound = Search.JumpPointSearch(Grid, StartCell, GoalCell, PathCells);
+		break;
+	case GAPM_Hierarchical:
+		bFound = Search.HierarchicalSearch(Grid, StartCell, GoalCell, PathCells);
+		break;
+	case GAPM_AStar:
+	default:
+		// The only one that can take a long time, so slice it
+		if (Search.BeginAStar(Grid, StartCell, GoalCell))
+		{
+			ActivePath = PathComponent;
+			ActivePathGridVersion = Grid->GetGridVersion();
+			return;
+		}
+		break;
+	}
+
+	if (bFound)
+	{
+		PathCache.Add(PathCells, PathComponent->GetPathCacheOptions(PathComponent->SearchMode), Grid->GetGridVersion());
+	}
+	PathComponent->CompleteScheduledPath(bFound, PathCells);
+}
+
+
+void UGAPathRequestSubsystem::RunDijkstraRequest(FRequest& Request)
+{
+	const AGAGridActor* Grid = Request.Grid.Get();
+	FGAGridMap DistanceMap(Grid, Request.Bounds, FLT_MAX);
+	TArray<FGASparseCell> Reachable;
+
+	Search.SetMinClearance(Request.MinClearance);
+	const bool bSuccess = Search.Dijkstra(Grid, Request.StartCell, DistanceMap, &Reachable);
+	Request.OnDijkstraComplete.ExecuteIfBound(bSuccess, DistanceMap, Reachable);
+}
+
+
+void UGAPathRequestSubsystem::StepActivePath()
+{
+	UGAPathComponent* PathComponent = ActivePath.Get();
+	const AGAGridActor* Grid = PathComponent ? PathComponent->GetGridActor() : nullptr;
+
+	if (!Grid || (Grid->GetGridVersion() != ActivePathGridVersion))
+	{
+		// The grid changed under us, so what we have so far can't be trusted -- start again
+		ActivePath.Reset();
+		if (PathComponent)
+		{
+			StartPathRequest(PathComponent);
+		}
+		return;
+	}
+
+	TArray<FCellRef> PathCells;
+	const EGASearchStatus Status = Search.StepAStar(ExpansionsPerSlice, PathCells);
+	if (Status != EGASearchStatus::InProgress)
+	{
+		if (Status == EGASearchStatus::Found)
+		{
+			PathCache.Add(PathCells, PathComponent->GetPathCacheOptions(PathComponent->SearchMode), ActivePathGridVersion);
+		}
+		ActivePath.Reset();
+		PathComponent->CompleteScheduledPath(Status == EGASearchStatus::Found, PathCells);
+	}
+}
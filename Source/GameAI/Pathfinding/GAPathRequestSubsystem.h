@@ -0,0 +1,124 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GAGridSearch.h"
+#include "GAPathCache.h"
+#include "GAPathRequestSubsystem.generated.h"
+
+class UGAPathComponent;
+
+
+// Called when a queued Dijkstra request has run. The map and list are only valid for the duration of the call.
+DECLARE_DELEGATE_ThreeParams(FGAOnDijkstraComplete, bool /*bSuccess*/, const FGAGridMap& /*DistanceMap*/, const TArray<FGASparseCell>& /*Reachable*/);
+
+
+// Search contexts for path queries running on worker threads (see UGAPathComponent::RequestPathAsync)
+// A task borrows one for the length of its search and hands it back, so the grid-sized arrays get reused between
+// queries. There are only ever as many as there have been searches running at once, and they go with the world.
+// Shared with the tasks, so one that finishes after the world's gone still has somewhere to hand its search back to.
+class FGASearchPool
+{
+public:
+	// A free search, or a new one if they're all in use
+	TUniquePtr<FGAGridSearch> Acquire();
+
+	void Release(TUniquePtr<FGAGridSearch> Search);
+
+	// Number of searches made, and the memory held by the ones currently in the pool
+	int32 GetCreatedCount() const;
+	SIZE_T GetAllocatedSize() const;
+
+	void LogStats() const;
+
+private:
+	mutable FCriticalSection Lock;
+	TArray<TUniquePtr<FGAGridSearch>> FreeSearches;
+	int32 CreatedCount = 0;
+};
+
+
+// Queues up path and Dijkstra requests and works through them within a per-frame time budget
+// (GameAI.PathRequestBudgetUs), so a crowd of agents replanning on the same frame doesn't make a spike.
+//
+// Each frame we pick the most urgent request, which favours agents near the player and requests that have been
+// waiting a while. A* searches are sliced: if one runs out of budget it simply carries on next frame.
+// Jump point, hierarchical and Dijkstra requests are cheap enough that they always run to completion once started.
+//
+// Path results are handed back to the component (see UGAPathComponent::OnPathComplete).
+
+UCLASS()
+class UGAPathRequestSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	// Queue a path rebuild for PathComponent. The search uses wherever its pawn and destination are when the
+	// request gets serviced, so re-requesting while already queued does nothing. If its search is already
+	// underway, it gets restarted.
+	void RequestPath(UGAPathComponent* PathComponent);
+
+	// Drop any queued or in-progress request for PathComponent
+	void CancelPath(UGAPathComponent* PathComponent);
+
+	// Is there a queued or in-progress request for PathComponent?
+	bool IsPathPending(const UGAPathComponent* PathComponent) const;
+
+	// Queue a Dijkstra over Bounds from StartCell, only through cells with at least MinClearance
+	void RequestDijkstra(const AGAGridActor* Grid, const FCellRef& StartCell, const FGridBox& Bounds, FGAOnDijkstraComplete OnComplete, uint8 MinClearance = 0);
+
+	int32 GetQueuedCount() const { return Requests.Num(); }
+
+	// Recent path results, shared by every path component in the world (see GameAI.PathCacheStats)
+	FGAPathCache& GetPathCache() { return PathCache; }
+
+	// Search contexts for async path queries (see GameAI.SearchPoolStats)
+	TSharedRef<FGASearchPool, ESPMode::ThreadSafe> GetSearchPool() const { return SearchPool; }
+
+	// Priority weights: how many units of distance to the player one second of waiting is worth
+	float StalenessWeight = 2000.0f;
+
+	// Cells settled between budget checks when slicing an A*
+	int32 ExpansionsPerSlice = 256;
+
+private:
+	struct FRequest
+	{
+		// Set for path requests...
+		TWeakObjectPtr<UGAPathComponent> PathComponent;
+
+		// ...and these for Dijkstra requests
+		TWeakObjectPtr<const AGAGridActor> Grid;
+		FCellRef StartCell;
+		FGridBox Bounds;
+		uint8 MinClearance = 0;
+		FGAOnDijkstraComplete OnDijkstraComplete;
+
+		double RequestTime = 0.0;
+	};
+
+	float GetPriority(const FRequest& Request, const FVector& PlayerLocation, double Now) const;
+
+	// Pop the most urgent request and start it. False if the queue is empty.
+	bool StartNextRequest();
+
+	void StartPathRequest(UGAPathComponent* PathComponent);
+	void RunDijkstraRequest(FRequest& Request);
+	void StepActivePath();
+
+	TArray<FRequest> Requests;
+
+	// The path search currently being sliced, if any
+	TWeakObjectPtr<UGAPathComponent> ActivePath;
+	double ActivePathRequestTime = 0.0;
+	uint32 ActivePathGridVersion = 0;
+
+	FGAGridSearch Search;
+
+	FGAPathCache PathCache;
+
+	TSharedRef<FGASearchPool, ESPMode::ThreadSafe> SearchPool = MakeShared<FGASearchPool, ESPMode::ThreadSafe>();
+};
@@ -86,50 +86,31 @@ APawn* UGASpatialComponent::GetOwnerPawn() const
 	return NULL;
 }
 
-static void CameFromToPath(const TMap<FCellRef, FVector>& CameFrom, const FVector& start, const FVector& goal, TArray<FVector>& path, const AGAGridActor* GridActor)
+const UGASpatialFunction* UGASpatialComponent::GetSpatialFunction() const
 {
-	path.Empty();
-
-	FVector current = goal;
-	while (current != start)
+	if (SpatialFunctionReference.Get() == NULL)
 	{
-		path.Add(current);
-		FCellRef CurrentCell;
-		if ((GridActor->GetCellRef(current, false).IsValid()) || !CameFrom.Contains(CurrentCell))
-		{
-			// Unable to reconstruct the path
-			return;
-		}
-		current = CameFrom[CurrentCell];
+		UE_LOG(LogTemp, Warning, TEXT("UGASpatialComponent has no SpatialFunctionReference assigned."));
+		return NULL;
 	}
 
-	// Add the start point to the path
-	path.Add(start);
-
-	// Reverse the path to have it in the correct order
-	Algo::Reverse(path);
+	// Don't worry too much about the Unreal-ism below. Technically our SpatialFunctionReference is not ACTUALLY
+	// a spatial function instance, rather it's a class, which happens to have a lot of data in it.
+	// Happily, Unreal creates, under the hood, a default object for every class, that lets you access that data
+	// as if it were a normal instance
+	return SpatialFunctionReference->GetDefaultObject<UGASpatialFunction>();
 }
 
 
-bool UGASpatialComponent::ChoosePosition(bool PathfindToPosition, bool Debug)
+bool UGASpatialComponent::GatherReachable(FGAGridMap& GridMapOut, TArray<FGASparseCell>& ReachableOut) const
 {
-	bool Result = false;
 	const APawn* OwnerPawn = GetOwnerPawn();
 	const AGAGridActor* Grid = GetGridActor();
-	FCellRef BestCell;
-
-	if (SpatialFunctionReference.Get() == NULL)
+	if (!OwnerPawn || !Grid)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("UGASpatialComponent has no SpatialFunctionReference assigned."));
 		return false;
 	}
 
-	// Don't worry too much about the Unreal-ism below. Technically our SpatialFunctionReference is not ACTUALLY
-	// a spatial function instance, rather it's a class, which happens to have a lot of data in it.
-	// Happily, Unreal creates, under the hood, a default object for every class, that lets you access that data
-	// as if it were a normal instance
-	const UGASpatialFunction* SpatialFunction = SpatialFunctionReference->GetDefaultObject<UGASpatialFunction>();
-
 	// The below is to create a GridMap (which you will fill in) based on a bounding box centered around the OwnerPawn
 
 	FBox2D Box(EForceInit::ForceInit);
@@ -137,249 +118,344 @@ bool UGASpatialComponent::ChoosePosition(bool PathfindToPosition, bool Debug)
 	FVector2D PawnLocation(OwnerPawn->GetActorLocation());
 	Box += PawnLocation;
 	Box = Box.ExpandBy(SampleDimensions / 2.0f);
-	if (GridActor->GridSpaceBoundsToRect2D(Box, CellRect))
+	if (!Grid->GridSpaceBoundsToRect2D(Box, CellRect))
 	{
-		// Super annoying, by the way, that FIntRect is not blueprint accessible, because it forces us instead
-		// to make a separate bp-accessible FStruct that represents _exactly the same thing_.
-		FGridBox GridBox(CellRect);
+		return false;
+	}
 
-		// This is the grid map I'm going to fill with values
-		FGAGridMap GridMap(Grid, GridBox, 0.0f);
+	// Super annoying, by the way, that FIntRect is not blueprint accessible, because it forces us instead
+	// to make a separate bp-accessible FStruct that represents _exactly the same thing_.
+	FGridBox GridBox(CellRect);
 
-		// Fill in this distance map using Dijkstra!
-		FGAGridMap DistanceMap(Grid, GridBox, FLT_MAX);
+	// This is the grid map I'm going to fill with values
+	GridMapOut = FGAGridMap(Grid, GridBox, 0.0f);
 
+	// Fill in this distance map using Dijkstra!
+	FGAGridMap DistanceMap(Grid, GridBox, FLT_MAX);
 
-		// ~~~ STEPS TO FILL IN FOR ASSIGNMENT 3 ~~~
 
-		// Step 1: Run Dijkstra's to determine which cells we should even be evaluating (the GATHER phase)
-		// (You should add a Dijkstra() function to the UGAPathComponent())
-		// I would recommend adding a method to the path component which looks something like
-		// bool UGAPathComponent::Dijkstra(const FVector &StartPoint, FGAGridMap &DistanceMapOut) const;
-		AActor* Owner = GetOwnerPawn();
-		FVector StartPoint = Owner->GetActorLocation();
-		UGAPathComponent* PathComp = GetPathComponent();
-		TMap<FCellRef, FVector> CameFrom;
-		PathComp->Dijkstra(StartPoint, DistanceMap, CameFrom);
+	// ~~~ STEPS TO FILL IN FOR ASSIGNMENT 3 ~~~
 
+	// Step 1: Run Dijkstra's to determine which cells we should even be evaluating (the GATHER phase)
+	// (You should add a Dijkstra() function to the UGAPathComponent())
+	// I would recommend adding a method to the path component which looks something like
+	// bool UGAPathComponent::Dijkstra(const FVector &StartPoint, FGAGridMap &DistanceMapOut) const;
+	FVector StartPoint = OwnerPawn->GetActorLocation();
+	UGAPathComponent* PathComp = GetPathComponent();
 
-		// Step 2: For each layer in the spatial function, evaluate and accumulate the layer in GridMap
-		// Note, only evaluate accessible cells found in step 1
-		for (const FFunctionLayer& Layer : SpatialFunction->Layers)
-		{
-			UE_LOG(LogTemp, Warning, TEXT("In Layers"));
-			// figure out how to evaluate each layer type, and accumulate the value in the GridMap
-			EvaluateLayer(Layer, GridMap, DistanceMap, BestCell);
-			UE_LOG(LogTemp, Warning, TEXT("Value: %d"), 3);
-		}
-		UE_LOG(LogTemp, Warning, TEXT("Best Cell: (%d, %d), Best Value: %f"), BestCell.X, BestCell.Y);
-		// Step 3: pick the best cell in GridMap
+	// If we're not standing in any region (e.g. we've been pushed into a wall), nothing is reachable, so don't
+	// bother with the rest
+	if (!PathComp || (Grid->GetComponent(Grid->GetCellRef(StartPoint)) == 0))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("UGASpatialComponent: owner isn't on a traversable cell, no position to choose."));
+		return false;
+	}
 
-		// Let's pretend for now we succeeded.
-		Result = true;
+	// Reachable ends up holding just the cells Dijkstra got to, which is usually a small part of the box
+	PathComp->Dijkstra(StartPoint, DistanceMap, &ReachableOut);
+	return true;
+}
 
-		if (PathfindToPosition)
-		{
-			// Step 4: Go there!
-			// This will involve reconstructing the path and then getting it into the UGAPathComponent
-			// Depending on what your cached Dijkstra data looks like, the path reconstruction might be implemented here
-			// or in the UGAPathComponent
-			FVector BestCellPosition;
-
-			// Assuming BestCell is already calculated somewhere in your code
-			// For example:
-			// BestCell = FindBestCell();
-
-			// Get the position of the BestCell
-			float BestCValue = 0;
-			if (BestCell.IsValid())
-			{
-				BestCellPosition = Grid->GetCellPosition(BestCell);
 
-				GridMap.GetValue(BestCell, BestCValue);
-			}
-			UE_LOG(LogTemp, Warning, TEXT("Best Cell: (%d, %d), Best Value: %f"), BestCell.X, BestCell.Y, BestCValue);
-			UE_LOG(LogTemp, Warning, TEXT("Destination: %s"), *BestCellPosition.ToString());
+bool UGASpatialComponent::ChoosePosition(bool PathfindToPosition, bool Debug)
+{
+	const UGASpatialFunction* SpatialFunction = GetSpatialFunction();
+	const APawn* PlayerPawn = UGameplayStatics::GetPlayerPawn(this, 0);
+	if (!SpatialFunction || !PlayerPawn)
+	{
+		return false;
+	}
 
-			PathComp->SetDestination(BestCellPosition, CameFrom);
+	FGAGridMap GridMap;
+	TArray<FGASparseCell> Reachable;
+	if (!GatherReachable(GridMap, Reachable))
+	{
+		return false;
+	}
 
+	// Step 2: For each layer in the spatial function, evaluate and accumulate the layer in GridMap
+	// Note, only evaluate accessible cells found in step 1
+	const FVector TargetPosition = PlayerPawn->GetActorLocation();
+	for (const FFunctionLayer& Layer : SpatialFunction->Layers)
+	{
+		// figure out how to evaluate each layer type, and accumulate the value in the GridMap
+		EvaluateLayer(Layer, GridMap, Reachable, TargetPosition);
+	}
 
+	FCellRef BestCell;
+	return FinishChoosePosition(GridMap, Reachable, PathfindToPosition, Debug, BestCell);
+}
 
-			// Reconstruct the path from the start point to the BestCell
-			/*TArray<FVector> PathPoints;
-			TMap<FCellRef, FVector> CameFrom;
-			CameFromToPath(CameFrom, StartPoint, BestCellPosition, PathPoints, Grid);
 
-			// Print out the values of PathPoints
-			UE_LOG(LogTemp, Warning, TEXT("PathPoints after CameFromToPath:"));
-			for (const FVector& Point : PathPoints)
-			{
-				UE_LOG(LogTemp, Warning, TEXT("Point: %s"), *Point.ToString());
-			}
+bool UGASpatialComponent::FinishChoosePosition(FGAGridMap& GridMap, const TArray<FGASparseCell>& Reachable, bool PathfindToPosition, bool Debug, FCellRef& BestCell)
+{
+	const AGAGridActor* Grid = GetGridActor();
+	UGAPathComponent* PathComp = GetPathComponent();
+	if (!Grid)
+	{
+		return false;
+	}
 
-			// Convert the array of points to Steps array
-			PathComp->Steps.SetNum(PathPoints.Num());
-			int32 i = 0;
-			for (const FVector& Point : PathPoints)
-			{
-				FCellRef CellRef = Grid->GetCellRef(Point);
-				ECellData CellData = Grid->GetCellData(CellRef);
-				// Check if the cell is traversable
-				if (CellData == ECellData::CellDataTraversable)
-				{
-					PathComp->Steps[i].Set(FVector2D(Point.X, Point.Y), CellRef);
-					++i;
-				}*/
+	// Step 3: pick the best cell in GridMap
+	// Only reached cells count, so only look at those
+	float BestValue = -FLT_MAX;
+	if (!GridMap.GetArgMaxSparse(Reachable, BestCell, BestValue))
+	{
+		BestCell = FCellRef::Invalid;
+	}
+	UE_LOG(LogTemp, Verbose, TEXT("Best Cell: (%d, %d), Best Value: %f"), BestCell.X, BestCell.Y, BestValue);
 
+	const bool Result = BestCell.IsValid();
+
+	// Nothing reached means nowhere to go, so leave the current destination alone
+	if (Result && PathfindToPosition && PathComp)
+	{
+		// Step 4: Go there!
+		// This will involve reconstructing the path and then getting it into the UGAPathComponent
+		// Depending on what your cached Dijkstra data looks like, the path reconstruction might be implemented here
+		// or in the UGAPathComponent
+		FVector BestCellPosition = FVector::ZeroVector;
 
+		// Get the position of the BestCell
+		BestCellPosition = Grid->GetCellPosition(BestCell);
 
+		PathComp->SetDestination(BestCellPosition);
+	}
+
+
+	if (Debug)
+	{
+		// Note: this outputs (basically) the results of the position selection
+		// However, you can get creative with the debugging here. For example, maybe you want
+		// to be able to examine the values of a specific layer in the spatial function
+		// You could create a separate debug map above (where you're doing the evaluations) and
+		// cache it off for debug rendering. Ideally you'd be able to control what layer you wanted to 
+		// see from blueprint
+
+		// The debug copy only gets read, so half precision is plenty
+		GridActor->DebugGridMap = GridMap;
+		GridActor->DebugGridMap.SetStorage(GAMS_Half);
+		GridActor->RefreshDebugTexture();
+		GridActor->DebugMeshComponent->SetVisibility(true);		//cheeky!
+	}
+
+	return Result;
+}
+
+
+bool UGASpatialComponent::ChoosePositionAsync(bool PathfindToPosition, bool Debug)
+{
+	// Anything still in flight is superseded. Its trace results will turn up under the old serial and get ignored.
+	Pending.Reset();
+	PendingSerial++;
+
+	const UGASpatialFunction* SpatialFunction = GetSpatialFunction();
+	const APawn* PlayerPawn = UGameplayStatics::GetPlayerPawn(this, 0);
+	UWorld* World = GetWorld();
+	if (!SpatialFunction || !PlayerPawn || !World)
+	{
+		return false;
+	}
+
+	TUniquePtr<FPendingChoice> Choice = MakeUnique<FPendingChoice>();
+	if (!GatherReachable(Choice->GridMap, Choice->Reachable))
+	{
+		return false;
+	}
+	Choice->TargetPosition = PlayerPawn->GetActorLocation();
+	Choice->bPathfindToPosition = PathfindToPosition;
+	Choice->bDebug = Debug;
+
+	const bool bNeedsTraces = SpatialFunction->Layers.ContainsByPredicate([](const FFunctionLayer& Layer)
+	{
+		return (Layer.Input == SI_LOS) && (Layer.LOSMode == SLOS_Physics);
+	});
+
+	Pending = MoveTemp(Choice);
+	if (!bNeedsTraces || (Pending->Reachable.Num() == 0))
+	{
+		// Nothing to wait for
+		CompletePendingChoice();
+		return true;
+	}
+
+	// Every physics LOS layer traces the same rays, so each cell only needs tracing once however many of them there are
+	const AGAGridActor* Grid = GetGridActor();
+	const FGAGridMap& GridMap = Pending->GridMap;
+
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(GASpatialLOS), false);
+	Params.AddIgnoredActor(GetOwnerPawn());
+	Params.AddIgnoredActor(PlayerPawn);
+
+	FTraceDelegate TraceDelegate;
+	TraceDelegate.BindUObject(this, &UGASpatialComponent::OnLOSTraceDone, PendingSerial);
+
+	Pending->Visibility.SetNumZeroed(Pending->Reachable.Num());
+	Pending->TracesOutstanding = Pending->Reachable.Num();
+	for (int32 Index = 0; Index < Pending->Reachable.Num(); Index++)
+	{
+		int32 X, Y;
+		GridMap.IndexToLocal(Pending->Reachable[Index].Index, X, Y);
+		FVector Start = Grid->GetCellPosition(FCellRef(X + GridMap.GridBounds.MinX, Y + GridMap.GridBounds.MinY));
+		Start.Z = Pending->TargetPosition.Z;		// same hack as the synchronous trace, see EvaluateLayer
+
+		World->AsyncLineTraceByChannel(EAsyncTraceType::Test, Start, Pending->TargetPosition, ECC_Visibility, Params,
+			FCollisionResponseParams::DefaultResponseParam, &TraceDelegate, uint32(Index));
+	}
+
+	return true;
+}
+
+
+void UGASpatialComponent::OnLOSTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum, uint32 Serial)
+{
+	if (!Pending.IsValid() || (Serial != PendingSerial))
+	{
+		// From a request that's since been superseded
+		return;
+	}
+
+	// A test trace reports a blocking hit as a single entry
+	const int32 Index = int32(Datum.UserData);
+	if (Pending->Visibility.IsValidIndex(Index))
+	{
+		Pending->Visibility[Index] = (Datum.OutHits.Num() == 0) ? 1 : 0;
+		Pending->TracesOutstanding--;
+	}
+
+	if (Pending->TracesOutstanding == 0)
+	{
+		CompletePendingChoice();
+	}
+}
+
+
+void UGASpatialComponent::CompletePendingChoice()
+{
+	TUniquePtr<FPendingChoice> Choice = MoveTemp(Pending);
+	const UGASpatialFunction* SpatialFunction = GetSpatialFunction();
+
+	bool bSuccess = false;
+	FVector Position = FVector::ZeroVector;
+	if (Choice.IsValid() && SpatialFunction)
+	{
+		for (const FFunctionLayer& Layer : SpatialFunction->Layers)
+		{
+			EvaluateLayer(Layer, Choice->GridMap, Choice->Reachable, Choice->TargetPosition, Choice->Visibility.Num() ? &Choice->Visibility : nullptr);
 		}
 
+		FCellRef BestCell;
+		bSuccess = FinishChoosePosition(Choice->GridMap, Choice->Reachable, Choice->bPathfindToPosition, Choice->bDebug, BestCell);
 
-		if (Debug)
+		const AGAGridActor* Grid = GetGridActor();
+		if (bSuccess && Grid)
 		{
-			// Note: this outputs (basically) the results of the position selection
-			// However, you can get creative with the debugging here. For example, maybe you want
-			// to be able to examine the values of a specific layer in the spatial function
-			// You could create a separate debug map above (where you're doing the evaluations) and
-			// cache it off for debug rendering. Ideally you'd be able to control what layer you wanted to 
-			// see from blueprint
-
-			GridActor->DebugGridMap = GridMap;
-			GridActor->RefreshDebugTexture();
-			GridActor->DebugMeshComponent->SetVisibility(true);		//cheeky!
+			Position = Grid->GetCellPosition(BestCell);
 		}
 	}
 
-	return Result;
+	OnPositionChosen.Broadcast(bSuccess, Position);
 }
 
 
-void UGASpatialComponent::EvaluateLayer(const FFunctionLayer& Layer, FGAGridMap& GridMap, FGAGridMap& DistanceMap, FCellRef& BestCell) const
+bool UGASpatialComponent::HasLineOfSight(const FVector& StartPoint, const FVector& EndPoint) const
 {
+	UWorld* World = GetWorld();
+	if (!World)
+	{
+		return false;
+	}
 
+	// Ignore the two pawns involved -- we care about what's between them
+	FCollisionQueryParams Params;
+	Params.AddIgnoredActor(GetOwnerPawn());
+	Params.AddIgnoredActor(UGameplayStatics::GetPlayerPawn(this, 0));
+
+	FHitResult HitResult;
+	return !World->LineTraceSingleByChannel(HitResult, StartPoint, EndPoint, ECollisionChannel::ECC_Visibility, Params);
+}
 
-	float BestValue = -FLT_MAX;
 
-	for (int32 Y = GridMap.GridBounds.MinY; Y < GridMap.GridBounds.MaxY; Y++)
+void UGASpatialComponent::EvaluateLayer(const FFunctionLayer& Layer, FGAGridMap& GridMap, const TArray<FGASparseCell>& Reachable, const FVector& PlayerPosition, const TArray<uint8>* PhysicsVisibility) const
+{
+	const AGAGridActor* Grid = GetGridActor();
+	if (!Grid || !GridMap.IsFloatValid())
 	{
-		for (int32 X = GridMap.GridBounds.MinX; X < GridMap.GridBounds.MaxX; X++)
-		{
-			AActor* OwnerPawn = GetOwnerPawn();
-			const AGAGridActor* Grid = GetGridActor();
-			APawn* PlayerPawn = UGameplayStatics::GetPlayerPawn(this, 0);
-			FVector PlayerPosition = PlayerPawn->GetActorLocation();
-			FCellRef CellRef(X, Y);
-			float CellValue;
+		return;
+	}
 
+	const FRichCurve* ResponseCurve = Layer.ResponseCurve.GetRichCurveConst();
+	const int32 MinX = GridMap.GridBounds.MinX;
+	const int32 MinY = GridMap.GridBounds.MinY;
+
+	const EGAMapOp MapOp =
+		(Layer.Op == ESpatialOp::SO_Add) ? EGAMapOp::Add :
+		(Layer.Op == ESpatialOp::SO_Multiply) ? EGAMapOp::Multiply : EGAMapOp::Assign;
+
+	// Grid LOS from every cell looks at the same target, so shadowcast once from the target's cell and look the
+	// answers up. (That makes it cell centre to cell centre, rather than to exactly where the player is standing.)
+	// If the grid has an exact baked visibility set, that's already a bit test per cell, so don't bother.
+	const FCellRef PlayerCell = Grid->GetCellRef(PlayerPosition);
+	const FGAVisibilitySet& VisibilitySet = Grid->GetVisibilitySet();
+	const bool bUseVisibilitySet = VisibilitySet.IsValidFor(Grid->XCount, Grid->YCount) && VisibilitySet.IsExact();
+	// The field's kept on the component, so it's only built once however many layers (or queries) use it.
+	if ((Layer.Input == ESpatialInput::SI_LOS) && (Layer.LOSMode == SLOS_Grid) && !bUseVisibilitySet &&
+		!VisibilityField.IsValidFor(Grid, PlayerCell, GridMap.GridBounds))
+	{
+		Grid->BuildVisibilityField(PlayerCell, GridMap.GridBounds, VisibilityField);
+	}
 
-			if (EnumHasAllFlags(Grid->GetCellData(CellRef), ECellData::CellDataTraversable))
-			{
+	// Evaluate the layer for just the reachable cells, and then fold it into GridMap in one pass.
+	// The layer starts as a copy of the reachable list, so each cell's path distance is right there when we get to it.
+	TArray<FGASparseCell> LayerCells = Reachable;
+
+	for (int32 CellIndex = 0; CellIndex < LayerCells.Num(); CellIndex++)
+	{
+		FGASparseCell& Cell = LayerCells[CellIndex];
+		const float PathDistance = Cell.Value;
 
-				// evaluate me!
-
-				float Value = 0.0f;
-				switch (Layer.Input)
-				{
-				case ESpatialInput::SI_None:
-					// No input, so value remains 0
-					break;
-				case ESpatialInput::SI_TargetRange:
-					// Evaluate distance to target and set as value
-					Value = FVector::DistSquared(Grid->GetCellPosition(CellRef), PlayerPosition);
-					break;
-				case ESpatialInput::SI_PathDistance:
-					// Retrieve path distance from the pre-calculated distance map
-					float PathDistanceValue;
-					Value = DistanceMap.GetValue(CellRef, PathDistanceValue);
-					break;
-				case ESpatialInput::SI_LOS:
-					// Cast a ray to check line of sight
-					UWorld* World = GetWorld();
-					FHitResult HitResult;
-					FCollisionQueryParams Params;
-					FVector Start = Grid->GetCellPosition(CellRef);  // Ray start from center of the cell
-					FVector End = PlayerPawn->GetActorLocation();    // Ray end at player's location
-					Start.Z = End.Z;  // Hack to align the ray with the player's Z position
-					Params.AddIgnoredActor(PlayerPawn);  // Ignore the player pawn
-					Params.AddIgnoredActor(OwnerPawn);   // Ignore the owner pawn (AI)
-
-					bool bHitSomething = World->LineTraceSingleByChannel(HitResult, Start, End, ECollisionChannel::ECC_Visibility, Params);
-					if (!bHitSomething)
-					{
-						// No obstruction found, clear LOS
-						Value = 1.0f;
-					}
-					else
-					{
-						// Obstruction found, no LOS
-						Value = 0.0f;
-					}
-					// Add cases for additional input types if needed
-				}
-
-				// Apply response curve to the value
-				float ModifiedValue = Layer.ResponseCurve.GetRichCurveConst()->Eval(Value);
-
-				// Apply operation based on layer operation type
-				switch (Layer.Op)
-				{
-				case ESpatialOp::SO_None:
-					// No operation, just set the modified value
-					GridMap.SetValue(CellRef, ModifiedValue);
-					break;
-				case ESpatialOp::SO_Add:
-					// Add modified value to the existing value in the grid map
-					if (GridMap.GetValue(CellRef, Value))
-					{
-						GridMap.SetValue(CellRef, ModifiedValue + GridMap.GetValue(CellRef, Value));
-					}
-					break;
-				case ESpatialOp::SO_Multiply:
-					// Multiply modified value with the existing value in the grid map
-					if (GridMap.GetValue(CellRef, Value))
-					{
-						GridMap.SetValue(CellRef, ModifiedValue * GridMap.GetValue(CellRef, Value));
-					}
-					break;
-					// Add cases for additional operation types if needed
-				}
-
-				if (GridMap.GetValue(CellRef, CellValue))
-				{
-					// Check if this cell has a higher value than the current best
-					if (CellValue > BestValue)
-					{
-						BestValue = CellValue;
-						BestCell = CellRef;
-						UE_LOG(LogTemp, Warning, TEXT("Best Cell: (%d, %d), Best Value: %f"), BestCell.X, BestCell.Y, BestValue);
-
-					}
-				}
-				UE_LOG(LogTemp, Warning, TEXT("Best Cell: (%d, %d), Best Value: %f"), BestCell.X, BestCell.Y, BestValue);
-
-
-
-				// HERE ARE SOME ADDITIONAL HINTS
-
-				// Here's how to get the player's pawn
-				// APawn *PlayerPawn = UGameplayStatics::GetPlayerPawn(this, 0);
-
-				// Here's how to cast a ray
-
-				// UWorld* World = GetWorld();
-				// FHitResult HitResult;
-				// FCollisionQueryParams Params;
-				// FVector Start = Grid->GetCellPosition(CellRef);		// need a ray start
-				// FVector End = PlayerPawn->GetActorLocation();		// need a ray end
-				// Start.Z = End.Z;		// Hack: we don't have Z information in the grid actor -- take the player's z value and raycast against that
-				// Add any actors that should be ignored by the raycast by calling
-				// Params.AddIgnoredActor(PlayerPawn);			// Probably want to ignore the player pawn
-				// Params.AddIgnoredActor(OwnerPawn);			// Probably want to ignore the AI themself
-				// bool bHitSomething = World->LineTraceSingleByChannel(HitResult, Start, End, ECollisionChannel::ECC_Visibility, Params);
-				// If bHitSomething is false, then we have a clear LOS
+		int32 X, Y;
+		GridMap.IndexToLocal(Cell.Index, X, Y);
+		const FCellRef CellRef(X + MinX, Y + MinY);
+		float Input = 0.0f;
+
+		switch (Layer.Input)
+		{
+		case ESpatialInput::SI_None:
+			// No input, so value remains 0
+			break;
+		case ESpatialInput::SI_TargetRange:
+			Input = FVector::DistSquared(Grid->GetCellPosition(CellRef), PlayerPosition);
+			break;
+		case ESpatialInput::SI_PathDistance:
+			// Dijkstra works in cells, so convert to world units
+			Input = PathDistance * Grid->CellScale;
+			break;
+		case ESpatialInput::SI_LOS:
+		{
+			FVector Start = Grid->GetCellPosition(CellRef);
+			if (Layer.LOSMode == SLOS_Grid)
+			{
+				const bool bVisible = bUseVisibilitySet ? Grid->HasCellLineOfSight(CellRef, PlayerCell) : VisibilityField.IsVisible(CellRef);
+				Input = bVisible ? 1.0f : 0.0f;
 			}
+			else if (PhysicsVisibility)
+			{
+				// Already traced, see ChoosePositionAsync
+				Input = (*PhysicsVisibility)[CellIndex];
+			}
+			else
+			{
+				Start.Z = PlayerPosition.Z;		// Hack: we don't have Z information in the grid actor -- take the player's z value and raycast against that
+				Input = HasLineOfSight(Start, PlayerPosition) ? 1.0f : 0.0f;
+			}
+			break;
 		}
+		}
+
+		// Apply response curve to the value
+		Cell.Value = ResponseCurve->Eval(Input);
 	}
-}
 
+	GridMap.CombineSparse(LayerCells, MapOp);
+}
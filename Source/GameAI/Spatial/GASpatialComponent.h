@@ -3,12 +3,18 @@
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
 #include "GameAI/Grid/GAGridActor.h"
+#include "GameAI/Grid/GAVisibilityField.h"
 #include "GASpatialComponent.generated.h"
 
 class UGASpatialFunction;
 struct FFunctionLayer;
 class AGAGridActor;
 class UGAPathComponent;
+struct FTraceHandle;
+struct FTraceDatum;
+
+// Fired when a ChoosePositionAsync finishes. Position is the centre of the chosen cell (zero if there wasn't one).
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FGAOnPositionChosen, bool, bSuccess, FVector, Position);
 
 // Our spatial component
 // This component is going to help make us make decisions about where to stand
@@ -54,7 +60,18 @@ class UGASpatialComponent : public UActorComponent
 	UFUNCTION(BlueprintCallable)
 	bool ChoosePosition(bool PathfindToPosition, bool Debug);
 
-	void EvaluateLayer(const FFunctionLayer& Layer, FGAGridMap& GridMap, FGAGridMap& DistanceMap, FCellRef& BestCell) const;
+	// Same as ChoosePosition, but the physics line of sight rays all go out together as async traces, and the position
+	// is chosen once they come back (normally next frame). Listen on OnPositionChosen for the result.
+	// Returns false if it couldn't get started. Calling it again before it's done abandons the earlier request.
+	UFUNCTION(BlueprintCallable)
+	bool ChoosePositionAsync(bool PathfindToPosition, bool Debug);
+
+	UPROPERTY(BlueprintAssignable)
+	FGAOnPositionChosen OnPositionChosen;
+
+	// Evaluate one layer over the reachable cells (as found by Dijkstra), and accumulate it into GridMap
+	// If PhysicsVisibility is given (one entry per reachable cell), physics LOS layers read it instead of tracing.
+	void EvaluateLayer(const FFunctionLayer& Layer, FGAGridMap& GridMap, const TArray<FGASparseCell>& Reachable, const FVector& PlayerPosition, const TArray<uint8>* PhysicsVisibility = nullptr) const;
 
 	// void EvaluateLayer(const FFunctionLayer& Layer, FGAGridMap& GridMap, FGAGridMap& DistanceMap, FCellRef BestCell) const;
 
@@ -62,5 +79,39 @@ class UGASpatialComponent : public UActorComponent
 
 	// void EvaluateLayer(const FFunctionLayer& Layer, FGAGridMap& GridMap) const;
 
+private:
+	const UGASpatialFunction* GetSpatialFunction() const;
+
+	// The gather phase: set up GridMap over the box around the owner, and find the cells we can reach
+	bool GatherReachable(FGAGridMap& GridMapOut, TArray<FGASparseCell>& ReachableOut) const;
+
+	// Pick the best reachable cell in the evaluated GridMap, and go there / show it if asked
+	bool FinishChoosePosition(FGAGridMap& GridMap, const TArray<FGASparseCell>& Reachable, bool PathfindToPosition, bool Debug, FCellRef& BestCell);
+
+	void OnLOSTraceDone(const FTraceHandle& Handle, FTraceDatum& Datum, uint32 Serial);
+
+	void CompletePendingChoice();
+
+	// An async choice waiting on its traces
+	struct FPendingChoice
+	{
+		FGAGridMap GridMap;
+		TArray<FGASparseCell> Reachable;
+		FVector TargetPosition;
+		bool bPathfindToPosition = false;
+		bool bDebug = false;
+
+		TArray<uint8> Visibility;		// 1 if the player is visible from the reachable cell with the same index
+		int32 TracesOutstanding = 0;
+	};
+
+	TUniquePtr<FPendingChoice> Pending;
+
+	// The grid LOS field for the last target cell we evaluated. Shared by every grid LOS layer, and kept between queries
+	// for as long as the target cell, the map box and the grid stay the same.
+	mutable FGAVisibilityField VisibilityField;
+
+	// Bumped by every ChoosePositionAsync, so traces from an abandoned request can be recognised
+	uint32 PendingSerial = 0;
 
 };
\ No newline at end of file
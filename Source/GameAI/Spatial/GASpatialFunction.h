@@ -17,6 +17,14 @@ enum ESpatialInput
 	// Add others if you want!
 };
 
+// How an SI_LOS layer decides whether a cell can see the target
+UENUM(BlueprintType)
+enum ESpatialLOSMode
+{
+	SLOS_Grid			UMETA(DisplayName = "Grid"),			// shadowcast over the grid's traversable cells from the target -- cheap and deterministic
+	SLOS_Physics		UMETA(DisplayName = "Physics Trace"),	// a real collision trace per cell
+};
+
 UENUM(BlueprintType)
 enum ESpatialOp
 {
@@ -38,7 +46,7 @@ struct FFunctionLayer
 {
 	GENERATED_USTRUCT_BODY()
 
-	FFunctionLayer() : Input(SI_None), Op(SO_None) {}
+	FFunctionLayer() : Input(SI_None), Op(SO_None), LOSMode(SLOS_Physics) {}
 
 	UPROPERTY(BlueprintReadOnly, EditAnywhere)
 	TEnumAsByte<ESpatialInput> Input;
@@ -49,6 +57,11 @@ struct FFunctionLayer
 	UPROPERTY(BlueprintReadOnly, EditAnywhere)
 	TEnumAsByte<ESpatialOp> Op;
 
+	// Only used by SI_LOS layers. Defaults to physics traces, which is what every layer did before there was a choice,
+	// so existing functions behave as they always have. Switch a layer to Grid explicitly to use the cheaper test.
+	UPROPERTY(BlueprintReadOnly, EditAnywhere)
+	TEnumAsByte<ESpatialLOSMode> LOSMode;
+
 };
 
 